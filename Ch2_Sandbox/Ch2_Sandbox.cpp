@@ -1,6 +1,74 @@
 #include <iostream>
 #include <cassert>
 #include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <climits>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HAS_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)
+#elif defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address)
+#endif
+
+// 16 ints to a 64 byte cache line, so prefetching node k * 16 fetches the cache line holding all
+// 16 of k's descendants four levels down.
+#define EYTZINGER_PREFETCH_BLOCK 16
+
+// Keys per static B-tree node: 16 ints fill one 64 byte cache line.
+#define STATIC_BTREE_B 16
+
+// Largest distance, in positions, between a learned index prediction and the true position of a
+// key it was fitted on.
+#define LEARNED_INDEX_EPSILON 32
+
+// Searches binarySearchBatch keeps in flight at once.
+#define BATCH_SEARCH_LANES 16
+
+// Independent accumulators per thread in the reduction engine, enough to fill a vector register
+// for most element types and to hide the latency of each add or compare.
+#define REDUCTION_LANES 16
+
+// Values each thread should get before the reduction engine bothers to start another one.
+#define PARALLEL_REDUCTION_THRESHOLD (1 << 16)
+
+// MSVC lets any function use AVX intrinsics; GCC and Clang need them enabled per function.
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#else
+#define TARGET_AVX2
+#endif
+
+bool cpuHasAvx2() {
+#if defined(HAS_X86_SIMD) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	__cpuid(info, 1);
+	bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+	__cpuidex(info, 7, 0);
+	return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#elif defined(HAS_X86_SIMD)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
 
 // assume arr is sorted
 int binarySearch(const int arr[], int start, int end, int target) {
@@ -36,6 +104,637 @@ void testBinarySearch() {
 	assert(binarySearch(arr_03, 0, 3, 6) == 6);
 }
 
+// Search index over a sorted array laid out in Eytzinger (breadth-first) order: node k's children
+// are 2k and 2k + 1. The top levels share a few hot cache lines and the addresses a few levels
+// down are known in advance, so the descent prefetches them instead of waiting on each miss, and
+// the loop body folds the comparison into the next index instead of branching on it.
+class EytzingerIndex {
+private:
+	int n;
+	std::vector<int> keys;  // 1 based, keys[0] is unused
+	std::vector<int> ranks; // position of keys[k] in the sorted input
+
+	// In-order walk of the implicit tree, handing out sorted values as it goes.
+	int build(const int arr[], int i, size_t k) {
+		if (k <= (size_t)n) {
+			i = build(arr, i, 2 * k);
+			keys[k] = arr[i];
+			ranks[k] = i;
+			i += 1;
+			i = build(arr, i, 2 * k + 1);
+		}
+		return i;
+	}
+
+	// Node holding the first value >= target, or 0 if there is none.
+	size_t lowerBoundNode(int target) const {
+		const int* base = keys.data();
+		size_t k = 1;
+		while (k <= (size_t)n) {
+			// Prefetch addresses may run past the end; they are only hints and never fault.
+			PREFETCH(reinterpret_cast<const int*>(reinterpret_cast<uintptr_t>(base) + k * EYTZINGER_PREFETCH_BLOCK * sizeof(int)));
+			k = 2 * k + (base[k] < target);
+		}
+		// Every right turn appended a 1 bit. Dropping the trailing right turns and the final left
+		// turn leads back to the last node where we went left, which is the answer.
+		while (k & 1) {
+			k >>= 1;
+		}
+		return k >> 1;
+	}
+
+public:
+	// assume arr is sorted
+	EytzingerIndex(const int arr[], int n) : n(n), keys(n + 1), ranks(n + 1) {
+		build(arr, 0, 1);
+	}
+
+	// Returns the index of the first value >= target in the original sorted array, or n if none.
+	int lowerBound(int target) const {
+		size_t k = lowerBoundNode(target);
+		return k == 0 ? n : ranks[k];
+	}
+
+	// Returns the index of target in the original sorted array, or -1 if it is not there.
+	int find(int target) const {
+		size_t k = lowerBoundNode(target);
+		return k != 0 && keys[k] == target ? ranks[k] : -1;
+	}
+};
+
+void testEytzingerIndex() {
+	int arr_00[1] = {};
+	EytzingerIndex index_00(arr_00, 0);
+	assert(index_00.lowerBound(10) == 0);
+	assert(index_00.find(10) == -1);
+
+	int arr_02[] = { 1, 5, 8, 10, 30 };
+	EytzingerIndex index_02(arr_02, 5);
+	assert(index_02.find(10) == 3);
+	assert(index_02.find(9) == -1);
+	assert(index_02.lowerBound(0) == 0);
+	assert(index_02.lowerBound(9) == 3);
+	assert(index_02.lowerBound(31) == 5);
+
+	// Every size up to a few levels deep, with duplicates, against std::lower_bound.
+	for (int n = 1; n <= 100; n++) {
+		std::vector<int> arr(n);
+		for (int i = 0; i < n; i++) {
+			arr[i] = i / 3 * 2;
+		}
+		EytzingerIndex index(arr.data(), n);
+		for (int target = -1; target <= arr[n - 1] + 1; target++) {
+			int expected = (int)(std::lower_bound(arr.begin(), arr.end(), target) - arr.begin());
+			assert(index.lowerBound(target) == expected);
+			assert(index.find(target) == (expected < n && arr[expected] == target ? expected : -1));
+		}
+	}
+}
+
+// Number of keys in a sorted 16 key node that are less than target.
+unsigned nodeRankScalar(int target, const int* node) {
+	unsigned rank = 0;
+	for (int i = 0; i < STATIC_BTREE_B; i++) {
+		rank += node[i] < target;
+	}
+	return rank;
+}
+
+#ifdef HAS_X86_SIMD
+TARGET_AVX2
+unsigned nodeRankAvx2(int target, const int* node) {
+	__m256i x = _mm256_set1_epi32(target);
+	__m256i low = _mm256_cmpgt_epi32(x, _mm256_load_si256((const __m256i*)node));
+	__m256i high = _mm256_cmpgt_epi32(x, _mm256_load_si256((const __m256i*)(node + 8)));
+	unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(low))
+		| (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(high)) << 8;
+	return (unsigned)_mm_popcnt_u32(mask);
+}
+#endif
+
+// Static B+-tree (S-tree) over a sorted array for read-only lookup tables. Every node is one cache
+// line of 16 sorted keys with 17 implicit children, so a lookup touches about log17(n) cache lines
+// instead of the log2(n) dependent loads of binarySearch, and each node is searched with two AVX2
+// compares. The bottom layer is the sorted array itself padded to whole nodes, which makes the
+// final position the lower_bound index directly. Upper layers hold, for each child after the
+// first, the smallest key below it.
+class StaticBTree {
+private:
+	size_t n;
+	int height;
+	std::vector<size_t> layerOffsets; // start of each layer in tree, layer 0 is the sorted array
+	std::vector<int> storage;
+	int* tree;                        // storage aligned to a cache line
+	bool useAvx2;
+
+	static size_t blocks(size_t keys) {
+		return (keys + STATIC_BTREE_B - 1) / STATIC_BTREE_B;
+	}
+
+	// How many keys the layer above a layer of the given size needs: one per child after the first.
+	static size_t keysAbove(size_t keys) {
+		return (blocks(keys) + STATIC_BTREE_B) / (STATIC_BTREE_B + 1) * STATIC_BTREE_B;
+	}
+
+	unsigned nodeRank(int target, const int* node) const {
+#ifdef HAS_X86_SIMD
+		if (useAvx2) {
+			return nodeRankAvx2(target, node);
+		}
+#endif
+		return nodeRankScalar(target, node);
+	}
+
+public:
+	// assume arr is sorted
+	StaticBTree(const int arr[], int size) : n(size), height(1), useAvx2(cpuHasAvx2()) {
+		size_t keys = n;
+		size_t total = std::max((size_t)1, blocks(keys)) * STATIC_BTREE_B; // An empty array still gets one node.
+		layerOffsets.push_back(0);
+		while (keys > STATIC_BTREE_B) {
+			keys = keysAbove(keys);
+			layerOffsets.push_back(total);
+			total += blocks(keys) * STATIC_BTREE_B;
+			height += 1;
+		}
+		layerOffsets.push_back(total);
+
+		// One node of slack so the start can be rounded up to a cache line.
+		storage.assign(total + STATIC_BTREE_B, INT_MAX);
+		tree = reinterpret_cast<int*>((reinterpret_cast<uintptr_t>(storage.data()) + 63) & ~(uintptr_t)63);
+		std::copy(arr, arr + n, tree);
+
+		for (int h = 1; h < height; h++) {
+			for (size_t i = 0; i < layerOffsets[h + 1] - layerOffsets[h]; i++) {
+				// Key j of node k separates it from child j + 1; its value is the first leaf value
+				// reached by stepping into that child and then always left.
+				size_t k = i / STATIC_BTREE_B;
+				size_t j = i - k * STATIC_BTREE_B;
+				k = k * (STATIC_BTREE_B + 1) + j + 1;
+				for (int l = 1; l < h; l++) {
+					k *= STATIC_BTREE_B + 1;
+				}
+				tree[layerOffsets[h] + i] = k * STATIC_BTREE_B < n ? tree[k * STATIC_BTREE_B] : INT_MAX;
+			}
+		}
+	}
+
+	StaticBTree(const StaticBTree&) = delete;
+	StaticBTree& operator=(const StaticBTree&) = delete;
+
+	// Returns the index of the first value >= target in the original sorted array, or n if none.
+	int lowerBound(int target) const {
+		size_t k = 0;
+		for (int h = height - 1; h > 0; h--) {
+			unsigned i = nodeRank(target, tree + layerOffsets[h] + k);
+			k = k * (STATIC_BTREE_B + 1) + i * STATIC_BTREE_B;
+		}
+		size_t i = nodeRank(target, tree + k);
+		return (int)std::min(k + i, n);
+	}
+
+	// Returns how many values lie in [low, high).
+	int rangeCount(int low, int high) const {
+		return low < high ? lowerBound(high) - lowerBound(low) : 0;
+	}
+
+	size_t memoryBytes() const {
+		return storage.size() * sizeof(int);
+	}
+};
+
+void testStaticBTree() {
+	int arr_00[1] = {};
+	StaticBTree tree_00(arr_00, 0);
+	assert(tree_00.lowerBound(10) == 0);
+
+	int arr_02[] = { 1, 5, 8, 10, 30 };
+	StaticBTree tree_02(arr_02, 5);
+	assert(tree_02.lowerBound(10) == 3);
+	assert(tree_02.lowerBound(31) == 5);
+	assert(tree_02.rangeCount(5, 11) == 3);
+	assert(tree_02.rangeCount(11, 5) == 0);
+
+	// Sizes around one, two and three full layers, with duplicates, against std::lower_bound.
+	for (int n : { 1, 15, 16, 17, 272, 273, 300, 4624, 4625, 5000, 100000 }) {
+		std::vector<int> arr(n);
+		for (int i = 0; i < n; i++) {
+			arr[i] = i / 3 * 2 - n / 2;
+		}
+		StaticBTree tree(arr.data(), n);
+		std::vector<int> targets = { INT_MIN, INT_MAX };
+		for (int target = arr[0] - 1; target <= arr[n - 1] + 1; target++) {
+			targets.push_back(target);
+		}
+		for (int target : targets) {
+			int expected = (int)(std::lower_bound(arr.begin(), arr.end(), target) - arr.begin());
+			assert(tree.lowerBound(target) == expected);
+		}
+		assert(tree.rangeCount(INT_MIN, INT_MAX) == n);
+	}
+
+	// INT_MAX is also the padding value.
+	int arr_03[] = { 1, INT_MAX, INT_MAX };
+	StaticBTree tree_03(arr_03, 3);
+	assert(tree_03.lowerBound(INT_MAX) == 1);
+	assert(tree_03.rangeCount(2, INT_MAX) == 0);
+}
+
+// Times random lookups with binarySearch, EytzingerIndex and StaticBTree over sorted arrays from
+// 1K values up to maxSize, growing by 32x. maxSize = 1 << 30 covers 1G values but needs ~13 GB.
+void searchBigO(int maxSize) {
+	const int queryCount = 1 << 20;
+	std::mt19937 random(42);
+	for (long long size = 1 << 10; size <= maxSize; size <<= 5) {
+		int n = (int)size;
+		std::vector<int> arr(n);
+		for (int i = 0; i < n; i++) {
+			arr[i] = 2 * i;
+		}
+		std::vector<int> queries(queryCount);
+		for (int& query : queries) {
+			query = (int)(random() % (2ULL * n));
+		}
+
+		EytzingerIndex eytzinger(arr.data(), n);
+		StaticBTree tree(arr.data(), n);
+
+		long long checksum = 0;
+		auto begin = std::chrono::steady_clock::now();
+		for (int query : queries) {
+			checksum += binarySearch(arr.data(), 0, n - 1, query);
+		}
+		auto binaryTime = std::chrono::steady_clock::now() - begin;
+
+		begin = std::chrono::steady_clock::now();
+		for (int query : queries) {
+			checksum += eytzinger.lowerBound(query);
+		}
+		auto eytzingerTime = std::chrono::steady_clock::now() - begin;
+
+		begin = std::chrono::steady_clock::now();
+		for (int query : queries) {
+			checksum += tree.lowerBound(query);
+		}
+		auto treeTime = std::chrono::steady_clock::now() - begin;
+
+		auto nsPerQuery = [queryCount](std::chrono::steady_clock::duration d) {
+			return std::chrono::duration<double, std::nano>(d).count() / queryCount;
+		};
+		std::cout << "size " << n << ": binarySearch " << nsPerQuery(binaryTime)
+			<< " ns, Eytzinger " << nsPerQuery(eytzingerTime)
+			<< " ns, S-tree " << nsPerQuery(treeTime) << " ns per lookup" << std::endl;
+
+		// Keeps the compiler from skipping the lookups.
+		volatile long long sink = checksum;
+		(void)sink;
+	}
+}
+
+// One linear piece of a LearnedIndex, predicting startIndex + slope * (key - firstKey).
+struct LinearSegment {
+	int firstKey;
+	int startIndex;
+	double slope;
+};
+
+// Learned index over a sorted array: a piecewise-linear model of key -> position with bounded
+// error, fitted greedily with a shrinking cone of feasible slopes. For near-uniform keys such as
+// timestamps a handful of segments covers millions of values. A lookup picks the segment, predicts
+// a position and finishes with a lower_bound over the 2 * epsilon + 3 values around it. Keys that
+// fall in a gap between fitted keys can miss that window; the search then widens exponentially from
+// its edge, so a miss costs O(log distance) rather than a search over the rest of the array. The array is not copied and must outlive
+// the index.
+class LearnedIndex {
+private:
+	const int* arr;
+	int n;
+	int epsilon;
+	std::vector<LinearSegment> segments;
+
+	// First index after i holding a different value.
+	int nextDistinct(int i) const {
+		int j = i + 1;
+		while (j < n && arr[j] == arr[i]) {
+			j++;
+		}
+		return j;
+	}
+
+public:
+	// assume arr is sorted
+	LearnedIndex(const int arr[], int n, int epsilon = LEARNED_INDEX_EPSILON) : arr(arr), n(n), epsilon(epsilon) {
+		int i = 0;
+		while (i < n) {
+			LinearSegment segment = { arr[i], i, 0.0 };
+			double minSlope = 0.0;
+			double maxSlope = -1.0; // No constraint yet.
+
+			// Fit each distinct key's first position; stop when no slope keeps them all in bounds.
+			int j = nextDistinct(i);
+			while (j < n) {
+				double dx = (double)arr[j] - segment.firstKey;
+				double dy = (double)(j - i);
+				double low = (dy - epsilon) / dx;
+				double high = (dy + epsilon) / dx;
+				if (maxSlope >= 0 && (low > maxSlope || high < minSlope)) {
+					break;
+				}
+				minSlope = std::max(minSlope, low);
+				maxSlope = maxSlope < 0 ? high : std::min(maxSlope, high);
+				j = nextDistinct(j);
+			}
+			segment.slope = maxSlope < 0 ? 0.0 : (minSlope + maxSlope) / 2;
+			segments.push_back(segment);
+			i = j;
+		}
+	}
+
+	// Returns the index of the first value >= target, or n if none.
+	int lowerBound(int target) const {
+		if (n == 0 || target <= arr[0]) {
+			return 0;
+		}
+
+		// The last segment starting at or before target.
+		auto next = std::upper_bound(segments.begin(), segments.end(), target,
+			[](int key, const LinearSegment& segment) { return key < segment.firstKey; });
+		const LinearSegment& segment = *(next - 1);
+
+		double predicted = segment.startIndex + segment.slope * ((double)target - segment.firstKey);
+		int position = (int)std::min((double)n, std::max(0.0, predicted));
+		int low = std::max(0, position - epsilon - 1);
+		int high = std::min(n, position + epsilon + 2);
+
+		const int* found = std::lower_bound(arr + low, arr + high, target);
+		if (found == arr + high && high < n) {
+			// Everything before high is smaller: gallop right until a value >= target is passed.
+			int step = 1;
+			int end = std::min(n, high + step);
+			while (end < n && arr[end - 1] < target) {
+				high = end;
+				step *= 2;
+				end = std::min(n, high + step);
+			}
+			return (int)(std::lower_bound(arr + high, arr + end, target) - arr);
+		}
+		if (found == arr + low && low > 0 && arr[low - 1] >= target) {
+			// arr[low - 1] is already large enough: gallop left until a smaller value is passed.
+			int step = 1;
+			int last = low - 1;
+			int begin = std::max(0, last - step);
+			while (begin > 0 && arr[begin] >= target) {
+				last = begin;
+				step *= 2;
+				begin = std::max(0, last - step);
+			}
+			return (int)(std::lower_bound(arr + begin, arr + last, target) - arr);
+		}
+		return (int)(found - arr);
+	}
+
+	size_t segmentCount() const {
+		return segments.size();
+	}
+
+	size_t memoryBytes() const {
+		return segments.size() * sizeof(LinearSegment);
+	}
+};
+
+void testLearnedIndex() {
+	int arr_00[1] = {};
+	LearnedIndex index_00(arr_00, 0);
+	assert(index_00.lowerBound(10) == 0);
+
+	int arr_02[] = { 1, 5, 8, 10, 30 };
+	LearnedIndex index_02(arr_02, 5, 0);
+	assert(index_02.lowerBound(10) == 3);
+	assert(index_02.lowerBound(9) == 3);
+	assert(index_02.lowerBound(31) == 5);
+
+	// Uniform, duplicated and quadratic keys with tight and loose error bounds.
+	const int n = 5000;
+	for (int shape = 0; shape < 3; shape++) {
+		std::vector<int> arr(n);
+		for (int i = 0; i < n; i++) {
+			arr[i] = shape == 0 ? 3 * i : shape == 1 ? i / 50 * 7 : i * i / 10;
+		}
+		for (int epsilon : { 0, 2, LEARNED_INDEX_EPSILON }) {
+			LearnedIndex index(arr.data(), n, epsilon);
+			for (int target = arr[0] - 2; target <= arr[n - 1] + 2; target += 1 + target / 1000) {
+				int expected = (int)(std::lower_bound(arr.begin(), arr.end(), target) - arr.begin());
+				assert(index.lowerBound(target) == expected);
+			}
+		}
+	}
+
+	// Long runs of one key between sparse keys: targets in the gaps after a run are predicted
+	// inside the run, far from their answer, and must be found by widening in either direction.
+	std::vector<int> gaps;
+	for (int run = 0; run < 8; run++) {
+		gaps.insert(gaps.end(), 1 + (run * 977) % 3000, run * 1000);
+		for (int i = 1; i < 10; i++) {
+			gaps.push_back(run * 1000 + i * 50);
+		}
+	}
+	for (int epsilon : { 0, 2, LEARNED_INDEX_EPSILON }) {
+		LearnedIndex index(gaps.data(), (int)gaps.size(), epsilon);
+		for (int target = -1; target <= 8000; target++) {
+			int expected = (int)(std::lower_bound(gaps.begin(), gaps.end(), target) - gaps.begin());
+			assert(index.lowerBound(target) == expected);
+		}
+	}
+}
+
+// Times random lookups with binarySearch and LearnedIndex over near-uniform timestamps (a fixed
+// step plus jitter) and reports the index's size next to the array's.
+void learnedIndexBigO(int maxSize) {
+	const int queryCount = 1 << 20;
+	std::mt19937 random(7);
+	for (long long size = 1 << 10; size <= maxSize; size <<= 5) {
+		int n = (int)size;
+		std::vector<int> arr(n);
+		for (int i = 0; i < n; i++) {
+			arr[i] = 16 * i + (int)(random() % 16);
+		}
+		std::vector<int> queries(queryCount);
+		for (int& query : queries) {
+			query = (int)(random() % (16ULL * n));
+		}
+		LearnedIndex index(arr.data(), n);
+
+		long long checksum = 0;
+		auto begin = std::chrono::steady_clock::now();
+		for (int query : queries) {
+			checksum += binarySearch(arr.data(), 0, n - 1, query);
+		}
+		auto binaryTime = std::chrono::steady_clock::now() - begin;
+
+		begin = std::chrono::steady_clock::now();
+		for (int query : queries) {
+			checksum += index.lowerBound(query);
+		}
+		auto learnedTime = std::chrono::steady_clock::now() - begin;
+
+		volatile long long sink = checksum;
+		(void)sink;
+
+		auto nsPerQuery = [queryCount](std::chrono::steady_clock::duration d) {
+			return std::chrono::duration<double, std::nano>(d).count() / queryCount;
+		};
+		std::cout << "size " << n << ": binarySearch " << nsPerQuery(binaryTime)
+			<< " ns, learned index " << nsPerQuery(learnedTime) << " ns per lookup, "
+			<< index.segmentCount() << " segments, " << index.memoryBytes() << " bytes for "
+			<< (size_t)n * sizeof(int) << " bytes of keys" << std::endl;
+	}
+}
+
+// Merge-style pass for queries that arrive in ascending order: each answer is at or after the
+// previous one, so gallop forward from it and finish with a lower_bound over the last step.
+void binarySearchBatchSorted(const int* arr, int n, const int* queries, int m, int* out) {
+	long long position = 0;
+	for (int i = 0; i < m; i++) {
+		int target = queries[i];
+		long long low = position;
+		long long high = position;
+		long long step = 1;
+		while (high < n && arr[high] < target) {
+			low = high + 1;
+			high = position + step;
+			step *= 2;
+		}
+		high = std::min(high, (long long)n);
+		position = std::lower_bound(arr + low, arr + high, target) - arr;
+		out[i] = (int)position;
+	}
+}
+
+// Answers m lookups at once: out[i] is the index of the first value >= queries[i] in the sorted
+// array arr of length n, or n if there is none. Unlike binarySearch it returns positions.
+//
+// Each group of BATCH_SEARCH_LANES queries runs branchless binary searches in lockstep. Their
+// ranges shrink identically, so every round issues prefetches for all lanes' next probes before
+// doing any comparisons, and the cache misses of the group overlap instead of queueing up. Sorted
+// query batches take a merge-style galloping pass instead.
+void binarySearchBatch(const int* arr, int n, const int* queries, int m, int* out) {
+	if (n == 0) {
+		std::fill(out, out + m, 0);
+		return;
+	}
+	if (std::is_sorted(queries, queries + m)) {
+		binarySearchBatchSorted(arr, n, queries, m, out);
+		return;
+	}
+
+	for (int group = 0; group < m; group += BATCH_SEARCH_LANES) {
+		int lanes = std::min(BATCH_SEARCH_LANES, m - group);
+		const int* targets = queries + group;
+		const int* base[BATCH_SEARCH_LANES];
+		for (int lane = 0; lane < lanes; lane++) {
+			base[lane] = arr;
+		}
+
+		size_t length = (size_t)n;
+		while (length > 1) {
+			size_t half = length / 2;
+			size_t nextHalf = (length - half) / 2;
+			for (int lane = 0; lane < lanes; lane++) {
+				PREFETCH(base[lane] + nextHalf);
+				PREFETCH(base[lane] + half + nextHalf);
+			}
+			for (int lane = 0; lane < lanes; lane++) {
+				base[lane] = base[lane][half] < targets[lane] ? base[lane] + half : base[lane];
+			}
+			length -= half;
+		}
+
+		for (int lane = 0; lane < lanes; lane++) {
+			out[group + lane] = (int)(base[lane] - arr) + (*base[lane] < targets[lane]);
+		}
+	}
+}
+
+void testBinarySearchBatch() {
+	int arr_00[1] = {};
+	int queries_00[] = { 3, 1 };
+	int out_00[2] = { -1, -1 };
+	binarySearchBatch(arr_00, 0, queries_00, 2, out_00);
+	assert(out_00[0] == 0 && out_00[1] == 0);
+
+	std::mt19937 random(3);
+	for (int n : { 1, 2, 3, 16, 17, 1000 }) {
+		std::vector<int> arr(n);
+		for (int i = 0; i < n; i++) {
+			arr[i] = i / 2 * 3;
+		}
+		for (int m : { 1, 15, 16, 33, 500 }) {
+			std::vector<int> queries(m);
+			for (int& query : queries) {
+				query = (int)(random() % (2 * n + 4)) - 2;
+			}
+			for (int sorted = 0; sorted < 2; sorted++) {
+				if (sorted) {
+					std::sort(queries.begin(), queries.end());
+				}
+				std::vector<int> out(m);
+				binarySearchBatch(arr.data(), n, queries.data(), m, out.data());
+				for (int i = 0; i < m; i++) {
+					assert(out[i] == (int)(std::lower_bound(arr.begin(), arr.end(), queries[i]) - arr.begin()));
+				}
+			}
+		}
+	}
+}
+
+// Reports lookups per second for one binarySearch call per key, binarySearchBatch on random keys
+// and binarySearchBatch on the same keys sorted, over sorted arrays from 1K values to maxSize.
+void binarySearchBatchBigO(int maxSize) {
+	const int queryCount = 1 << 20;
+	std::mt19937 random(11);
+	for (long long size = 1 << 10; size <= maxSize; size <<= 5) {
+		int n = (int)size;
+		std::vector<int> arr(n);
+		for (int i = 0; i < n; i++) {
+			arr[i] = 2 * i;
+		}
+		std::vector<int> queries(queryCount);
+		for (int& query : queries) {
+			query = (int)(random() % (2ULL * n));
+		}
+		std::vector<int> sortedQueries = queries;
+		std::sort(sortedQueries.begin(), sortedQueries.end());
+		std::vector<int> out(queryCount);
+
+		long long checksum = 0;
+		auto begin = std::chrono::steady_clock::now();
+		for (int query : queries) {
+			checksum += binarySearch(arr.data(), 0, n - 1, query);
+		}
+		auto singleTime = std::chrono::steady_clock::now() - begin;
+
+		begin = std::chrono::steady_clock::now();
+		binarySearchBatch(arr.data(), n, queries.data(), queryCount, out.data());
+		auto batchTime = std::chrono::steady_clock::now() - begin;
+		checksum += out[queryCount / 2];
+
+		begin = std::chrono::steady_clock::now();
+		binarySearchBatch(arr.data(), n, sortedQueries.data(), queryCount, out.data());
+		auto sortedTime = std::chrono::steady_clock::now() - begin;
+		checksum += out[queryCount / 2];
+
+		volatile long long sink = checksum;
+		(void)sink;
+
+		auto lookupsPerSecond = [queryCount](std::chrono::steady_clock::duration d) {
+			return queryCount / std::chrono::duration<double>(d).count();
+		};
+		std::cout << "size " << n << ": binarySearch " << lookupsPerSecond(singleTime)
+			<< ", batch " << lookupsPerSecond(batchTime)
+			<< ", sorted batch " << lookupsPerSecond(sortedTime) << " lookups/second" << std::endl;
+	}
+}
+
 // assume arr is not empty
 int findMax(const int arr[], int start, int end) {
 	if (start == end) {
@@ -58,6 +757,207 @@ void testFindMax() {
 	assert(findMax(arr_01, 0, 4) == 364);
 }
 
+// Type reduceSum accumulates in: double for floating point, 64 bits for integers.
+template<typename T>
+struct SumType {
+	typedef typename std::conditional<std::is_floating_point<T>::value, double,
+		typename std::conditional<std::is_signed<T>::value, long long, unsigned long long>::type>::type type;
+};
+
+// Reductions for the engine. Each one folds values into an accumulator and merges accumulators
+// from different lanes or threads; ties keep the earlier value so argmax reports the first index.
+template<typename T>
+struct MaxReduction {
+	typedef T Accumulator;
+	static Accumulator start(const T* arr, size_t i) { return arr[i]; }
+	static Accumulator fold(Accumulator a, const T* arr, size_t i) { return arr[i] > a ? arr[i] : a; }
+	static Accumulator merge(Accumulator a, Accumulator b) { return b > a ? b : a; }
+};
+
+template<typename T>
+struct MinReduction {
+	typedef T Accumulator;
+	static Accumulator start(const T* arr, size_t i) { return arr[i]; }
+	static Accumulator fold(Accumulator a, const T* arr, size_t i) { return arr[i] < a ? arr[i] : a; }
+	static Accumulator merge(Accumulator a, Accumulator b) { return b < a ? b : a; }
+};
+
+template<typename T>
+struct ArgMaxReduction {
+	struct Accumulator {
+		T value;
+		size_t index;
+	};
+	static Accumulator start(const T* arr, size_t i) { return { arr[i], i }; }
+	static Accumulator fold(Accumulator a, const T* arr, size_t i) { return arr[i] > a.value ? Accumulator{ arr[i], i } : a; }
+	static Accumulator merge(Accumulator a, Accumulator b) {
+		return b.value > a.value || (b.value == a.value && b.index < a.index) ? b : a;
+	}
+};
+
+template<typename T>
+struct SumReduction {
+	typedef typename SumType<T>::type Accumulator;
+	static Accumulator start(const T* arr, size_t i) { return arr[i]; }
+	static Accumulator fold(Accumulator a, const T* arr, size_t i) { return a + arr[i]; }
+	static Accumulator merge(Accumulator a, Accumulator b) { return a + b; }
+};
+
+// Reduces arr[begin, end), which must not be empty, on the calling thread. Lane l handles every
+// REDUCTION_LANES-th value, so the inner loop has no dependency between lanes and the compiler can
+// map the lanes onto SIMD registers for any arithmetic type.
+template<typename Reduction, typename T>
+typename Reduction::Accumulator reduceRange(const T* arr, size_t begin, size_t end) {
+	typename Reduction::Accumulator result = Reduction::start(arr, begin);
+	size_t i = begin + 1;
+	if (end - i >= 2 * REDUCTION_LANES) {
+		typename Reduction::Accumulator lanes[REDUCTION_LANES];
+		for (int lane = 0; lane < REDUCTION_LANES; lane++) {
+			lanes[lane] = Reduction::start(arr, i + lane);
+		}
+		for (i += REDUCTION_LANES; end - i >= REDUCTION_LANES; i += REDUCTION_LANES) {
+			for (int lane = 0; lane < REDUCTION_LANES; lane++) {
+				lanes[lane] = Reduction::fold(lanes[lane], arr, i + lane);
+			}
+		}
+		for (int lane = 0; lane < REDUCTION_LANES; lane++) {
+			result = Reduction::merge(result, lanes[lane]);
+		}
+	}
+	for (; i < end; i++) {
+		result = Reduction::merge(result, Reduction::start(arr, i));
+	}
+	return result;
+}
+
+// Splits arr[0, n) into one contiguous block per thread once there are at least
+// PARALLEL_REDUCTION_THRESHOLD values for each, reduces the blocks concurrently and merges the
+// partial results in block order. threadCount 0 uses one thread per hardware thread.
+template<typename Reduction, typename T>
+typename Reduction::Accumulator reduceParallel(const T* arr, size_t n, unsigned threadCount) {
+	static_assert(std::is_arithmetic<T>::value, "The reduction engine works on arithmetic types.");
+	if (n == 0) {
+		throw std::invalid_argument("Reduction of an empty array.");
+	}
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	size_t blocks = std::min((size_t)threadCount, std::max((size_t)1, n / PARALLEL_REDUCTION_THRESHOLD));
+	if (blocks == 1) {
+		return reduceRange<Reduction>(arr, 0, n);
+	}
+
+	std::vector<typename Reduction::Accumulator> partial(blocks);
+	std::vector<std::thread> threads;
+	for (size_t block = 1; block < blocks; block++) {
+		threads.emplace_back([&, block]() {
+			partial[block] = reduceRange<Reduction>(arr, n * block / blocks, n * (block + 1) / blocks);
+		});
+	}
+	partial[0] = reduceRange<Reduction>(arr, 0, n / blocks);
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	typename Reduction::Accumulator result = partial[0];
+	for (size_t block = 1; block < blocks; block++) {
+		result = Reduction::merge(result, partial[block]);
+	}
+	return result;
+}
+
+// assume n > 0
+template<typename T>
+T reduceMax(const T* arr, size_t n, unsigned threadCount = 0) {
+	return reduceParallel<MaxReduction<T>>(arr, n, threadCount);
+}
+
+// assume n > 0
+template<typename T>
+T reduceMin(const T* arr, size_t n, unsigned threadCount = 0) {
+	return reduceParallel<MinReduction<T>>(arr, n, threadCount);
+}
+
+// assume n > 0; returns the first index holding the maximum
+template<typename T>
+size_t reduceArgMax(const T* arr, size_t n, unsigned threadCount = 0) {
+	return reduceParallel<ArgMaxReduction<T>>(arr, n, threadCount).index;
+}
+
+template<typename T>
+typename SumType<T>::type reduceSum(const T* arr, size_t n, unsigned threadCount = 0) {
+	return n == 0 ? 0 : reduceParallel<SumReduction<T>>(arr, n, threadCount);
+}
+
+void testReductions() {
+	int arr_00[] = { 1 };
+	assert(reduceMax(arr_00, 1) == 1);
+	assert(reduceArgMax(arr_00, 1) == 0);
+	assert(reduceSum(arr_00, 0) == 0);
+
+	int arr_01[] = { 4, 19, 38, 364, 38 };
+	assert(reduceMax(arr_01, 5) == findMax(arr_01, 0, 4));
+	assert(reduceMin(arr_01, 5) == 4);
+	assert(reduceSum(arr_01, 5) == 463);
+
+	// Sizes around the lane width, with several threads, against findMax and a plain loop.
+	std::mt19937 random(5);
+	for (size_t n : { (size_t)2, (size_t)31, (size_t)33, (size_t)1000, (size_t)4 * PARALLEL_REDUCTION_THRESHOLD + 3 }) {
+		std::vector<int> ints(n);
+		std::vector<double> doubles(n);
+		std::vector<unsigned char> bytes(n);
+		for (size_t i = 0; i < n; i++) {
+			ints[i] = (int)(random() % 2001) - 1000;
+			doubles[i] = ints[i] / 8.0;
+			bytes[i] = (unsigned char)(random() % 256);
+		}
+		for (unsigned threads : { 1u, 3u, 4u }) {
+			assert(reduceMax(ints.data(), n, threads) == findMax(ints.data(), 0, (int)n - 1));
+			assert(reduceMin(doubles.data(), n, threads) == *std::min_element(doubles.begin(), doubles.end()));
+			assert(reduceArgMax(ints.data(), n, threads) == (size_t)(std::max_element(ints.begin(), ints.end()) - ints.begin()));
+
+			long long intSum = 0;
+			unsigned long long byteSum = 0;
+			for (size_t i = 0; i < n; i++) {
+				intSum += ints[i];
+				byteSum += bytes[i];
+			}
+			assert(reduceSum(ints.data(), n, threads) == intSum);
+			assert(reduceSum(bytes.data(), n, threads) == byteSum);
+			assert(reduceSum(doubles.data(), n, threads) == intSum / 8.0);
+		}
+	}
+}
+
+// Times findMax against reduceMax and reduceSum with 1 to maxThreads threads on n ints.
+void reductionBigO(size_t n, unsigned maxThreads) {
+	std::vector<int> arr(n);
+	std::mt19937 random(9);
+	for (int& value : arr) {
+		value = (int)random();
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+	long long checksum = findMax(arr.data(), 0, (int)n - 1);
+	std::cout << "findMax: " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() << " ms" << std::endl;
+
+	for (unsigned threads = 1; threads <= maxThreads; threads++) {
+		begin = std::chrono::steady_clock::now();
+		checksum += reduceMax(arr.data(), n, threads);
+		auto maxTime = std::chrono::steady_clock::now() - begin;
+
+		begin = std::chrono::steady_clock::now();
+		checksum += reduceSum(arr.data(), n, threads);
+		auto sumTime = std::chrono::steady_clock::now() - begin;
+
+		std::cout << threads << " threads: reduceMax " << std::chrono::duration<double, std::milli>(maxTime).count()
+			<< " ms, reduceSum " << std::chrono::duration<double, std::milli>(sumTime).count() << " ms" << std::endl;
+	}
+
+	volatile long long sink = checksum;
+	(void)sink;
+}
+
 // assume month > 1
 int rabbit(int month) {
 	if (month <= 2) {
@@ -69,5 +969,16 @@ int rabbit(int month) {
 }
 
 void main() {
+	testBinarySearch();
+	testEytzingerIndex();
+	testStaticBTree();
+	testLearnedIndex();
+	testBinarySearchBatch();
 	testFindMax();
+	testReductions();
+
+	searchBigO(1 << 25);
+	learnedIndexBigO(1 << 25);
+	binarySearchBatchBigO(1 << 25);
+	reductionBigO(1 << 26, std::max(1u, std::thread::hardware_concurrency()));
 }
\ No newline at end of file
@@ -2,6 +2,49 @@
 #include <cassert>
 #include <algorithm>
 #include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HAS_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC lets any function use AVX intrinsics; GCC and Clang need them enabled per function so the
+// rest of the program still runs on CPUs without them.
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
 
 using namespace std;
 
@@ -16,9 +59,85 @@ int* copyArray(const int arr[], int n) {
 	return r;
 }
 
-int chooseRandomPivotIndex(int start, int end) {
+#define INSERTION_SORT_THRESHOLD 16
+#define MAX_BAD_PARTITIONS 2
+#define SIMD_PARTITION_THRESHOLD 4096
+#define PARALLEL_SELECTION_THRESHOLD (1 << 20)
+#define PARTITION_SCRATCH_RETAINED (1 << 16)
+#define PIVOT_SAMPLE_SIZE 31
+#define HISTOGRAM_BITS 16
+#define DEFAULT_MAX_BUCKET_VALUES (1 << 24)
+#define KLL_DEFAULT_K 200
+#define FIBONACCI_TABLE_SIZE 94 // F(93) is the largest Fibonacci number that fits in 64 bits.
+#define FACTORIAL_TABLE_SIZE 21 // 20! is the largest factorial that fits in 64 bits.
+#define MAX_HANOI_RINGS 63
+#define MAX_TIMED_HANOI_MOVES (1ULL << 22)
+
+// Sorts arr[start..end] in place. Used for the small ranges left over at the end of selection
+// and for the groups of five in median-of-medians.
+void insertionSort(int arr[], int start, int end) {
+	for (int i = start + 1; i <= end; ++i) {
+		int value = arr[i];
+		int j = i - 1;
+		while (j >= start && arr[j] > value) {
+			arr[j + 1] = arr[j];
+			--j;
+		}
+		arr[j + 1] = value;
+	}
+}
+
+// Returns whichever of the first, middle and last indices holds the median of those three values.
+int chooseMedianOfThreePivotIndex(const int arr[], int start, int end) {
+	int mid = start + (end - start) / 2;
+	int a = arr[start];
+	int b = arr[mid];
+	int c = arr[end];
+	if (a < b) {
+		if (b < c) {
+			return mid;
+		}
+		return a < c ? end : start;
+	}
+	if (a < c) {
+		return start;
+	}
+	return b < c ? end : mid;
+}
+
+// How findKthSmallestValue splits each subrange. TwoWay is the classic s1/pivot/s2 split;
+// ThreeWay also gathers every key equal to the pivot, which finishes immediately on
+// duplicate-heavy (low-cardinality) data.
+enum class PartitionMode {
+	TwoWay,
+	ThreeWay
+};
+
+int findKthSmallestValue(int k, int arr[], int start, int end, PartitionMode mode = PartitionMode::ThreeWay);
+
+// Median-of-medians pivot selection. Sorts each group of five, gathers the group medians at the
+// front of the range and selects their median. The result is guaranteed to have at least 3/10 of
+// the range on either side of it, which is what gives findKthSmallestValue its linear worst case.
+//
+// Returns: Index of the chosen pivot. The range is permuted but still holds the same values.
+int chooseMedianOfMediansPivotIndex(int arr[], int start, int end) {
 	int n = (end + 1) - start;
-	return start + rand() % n;
+	if (n <= 5) {
+		insertionSort(arr, start, end);
+		return start + (n - 1) / 2;
+	}
+
+	int medianCount = 0;
+	for (int groupStart = start; groupStart <= end; groupStart += 5) {
+		int groupEnd = min(groupStart + 4, end);
+		insertionSort(arr, groupStart, groupEnd);
+		swap(arr[start + medianCount], arr[groupStart + (groupEnd - groupStart) / 2]);
+		medianCount += 1;
+	}
+
+	int mid = start + (medianCount - 1) / 2;
+	findKthSmallestValue(mid, arr, start, start + medianCount - 1);
+	return mid;
 }
 
 // Partitions an array into segments s1, and s2 where s1 contains all the values less
@@ -38,82 +157,1092 @@ int partition(int pivotIndex, int arr[], int start, int end) {
 	}
 	int pivotValue = arr[pivotIndex];
 
-	// Hints:
-	//       * The pivot is not included in s1 or s2, although there can be other elements equal to the pivot in s1 or s2.
-	//       * The pivot value determines what needs to move to s1 or s2;
-	//       * If you change the location of the pivot value don't forget to return the new pivotIndex.
-	//       * You might want to temporarily move the pivot value to aid in the process.
-	//       * You can do this multiple ways; one pass, two passes, from center out, from ends in.
-	//       * Use std::swap
+	// Hoare-style scan from both ends. The pivot is parked at the start so the right scan always
+	// has a sentinel, and both scans stop on keys equal to the pivot so runs of duplicates get
+	// split evenly instead of piling up on one side.
+	swap(arr[start], arr[pivotIndex]);
+	int i = start;
+	int j = end + 1;
+	while (true) {
+		do {
+			++i;
+		} while (i <= end && arr[i] < pivotValue);
+		do {
+			--j;
+		} while (arr[j] > pivotValue);
+
+		if (i >= j) {
+			break;
+		}
+		swap(arr[i], arr[j]);
+	}
+	swap(arr[start], arr[j]);
+	return j;
+}
+
+// The indices [lt, gt) holding the keys equal to the pivot after a three-way partition.
+struct EqualRange {
+	int lt;
+	int gt;
+};
+
+// Dutch national flag partition. Afterwards arr[start..lt) < pivot, arr[lt..gt) == pivot and
+// arr[gt..end] > pivot.
+//
+// pivotIndex: Index whose value is used to partition the input array.
+// start: The index in the array to start at.
+// end: The inclusive index in the array to end at.
+//
+// Returns: The range of keys equal to the pivot value. It is never empty.
+EqualRange partitionThreeWay(int pivotIndex, int arr[], int start, int end) {
+	assert((end + 1) - start != 0 && pivotIndex >= start && pivotIndex <= end);
+
+	int pivotValue = arr[pivotIndex];
+	int lt = start;
+	int i = start;
+	int gt = end + 1;
+	while (i < gt) {
+		if (arr[i] < pivotValue) {
+			swap(arr[lt], arr[i]);
+			lt += 1;
+			i += 1;
+		}
+		else if (arr[i] > pivotValue) {
+			gt -= 1;
+			swap(arr[i], arr[gt]);
+		}
+		else {
+			i += 1;
+		}
+	}
+	return { lt, gt };
+}
+
+// Widest vector instruction set the partition kernels can use on this CPU.
+enum class SimdLevel {
+	Scalar,
+	Avx2,
+	Avx512
+};
+
+SimdLevel detectSimdLevel() {
+#if defined(HAS_X86_SIMD) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return SimdLevel::Scalar;
+	}
+	__cpuid(info, 1);
+	bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+	bool osSavesZmm = osSavesYmm && (_xgetbv(0) & 0xE6) == 0xE6;
+	__cpuidex(info, 7, 0);
+	if (osSavesZmm && (info[1] & (1 << 16)) != 0) {
+		return SimdLevel::Avx512;
+	}
+	if (osSavesYmm && (info[1] & (1 << 5)) != 0) {
+		return SimdLevel::Avx2;
+	}
+#elif defined(HAS_X86_SIMD)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		return SimdLevel::Avx512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		return SimdLevel::Avx2;
+	}
+#endif
+	return SimdLevel::Scalar;
+}
+
+SimdLevel simdLevel() {
+	static const SimdLevel level = detectSimdLevel();
+	return level;
+}
+
+// For every 8 bit mask, the lane indices of its set bits packed to the front, and how many there are.
+// AVX2 has no compress instruction, so a permute through this table does the same job.
+struct CompressTable {
+	alignas(32) int permutations[256][8];
+	int counts[256];
+
+	CompressTable() {
+		for (int mask = 0; mask < 256; ++mask) {
+			int count = 0;
+			for (int lane = 0; lane < 8; ++lane) {
+				if (mask & (1 << lane)) {
+					permutations[mask][count] = lane;
+					count += 1;
+				}
+			}
+			counts[mask] = count;
+			for (int lane = count; lane < 8; ++lane) {
+				permutations[mask][lane] = 0;
+			}
+		}
+	}
+};
+
+const CompressTable COMPRESS_TABLE;
+
+// Values that go right are buffered here and copied back after the pass. One buffer per thread.
+thread_local vector<int> partitionScratchBuffer;
+thread_local int partitionScratchUsers = 0;
+
+int* partitionScratch(int n) {
+	if ((int)partitionScratchBuffer.size() < n + 16) {
+		partitionScratchBuffer.resize(n + 16);
+	}
+	return partitionScratchBuffer.data();
+}
+
+// Held for the duration of a top-level selection. When the outermost holder leaves, a scratch
+// buffer that grew past PARTITION_SCRATCH_RETAINED values is freed, so one huge call does not pin
+// its size in every thread that made it. Smaller buffers are kept for the next call.
+struct PartitionScratchScope {
+	PartitionScratchScope() {
+		partitionScratchUsers += 1;
+	}
+
+	~PartitionScratchScope() {
+		partitionScratchUsers -= 1;
+		if (partitionScratchUsers == 0 && partitionScratchBuffer.size() > PARTITION_SCRATCH_RETAINED) {
+			vector<int>().swap(partitionScratchBuffer);
+		}
+	}
+
+	PartitionScratchScope(const PartitionScratchScope&) = delete;
+	PartitionScratchScope& operator=(const PartitionScratchScope&) = delete;
+};
+
+// Whether value belongs on the left of a compress partition around pivotValue.
+bool goesLeft(int value, int pivotValue, bool orEqual) {
+	return orEqual ? value <= pivotValue : value < pivotValue;
+}
+
+// Scalar compress partition, also used for the tails of the vector kernels. left and right are
+// the write cursors for the two sides and are advanced past what was written.
+void compressPartitionScalar(int pivotValue, bool orEqual, const int* first, const int* last, int*& left, int*& right) {
+	for (const int* p = first; p != last; ++p) {
+		int value = *p;
+		if (goesLeft(value, pivotValue, orEqual)) {
+			*left++ = value;
+		}
+		else {
+			*right++ = value;
+		}
+	}
+}
+
+#ifdef HAS_X86_SIMD
+TARGET_AVX2
+void compressPartitionAvx2(int pivotValue, bool orEqual, const int* first, const int* last, int*& left, int*& right) {
+	const __m256i pivot = _mm256_set1_epi32(pivotValue);
+	const int* p = first;
+	for (; last - p >= 8; p += 8) {
+		__m256i values = _mm256_loadu_si256((const __m256i*)p);
+		__m256i greater = _mm256_cmpgt_epi32(values, pivot);
+		__m256i leftLanes = orEqual
+			? _mm256_xor_si256(greater, _mm256_set1_epi32(-1))
+			: _mm256_cmpgt_epi32(pivot, values);
+		int leftMask = _mm256_movemask_ps(_mm256_castsi256_ps(leftLanes));
+		int rightMask = ~leftMask & 0xFF;
+
+		// Full 8 lane stores: the left cursor never passes p, so the extra lanes only land on
+		// values that are already loaded, and the scratch buffer has 16 spare slots.
+		__m256i leftPermutation = _mm256_load_si256((const __m256i*)COMPRESS_TABLE.permutations[leftMask]);
+		__m256i rightPermutation = _mm256_load_si256((const __m256i*)COMPRESS_TABLE.permutations[rightMask]);
+		_mm256_storeu_si256((__m256i*)left, _mm256_permutevar8x32_epi32(values, leftPermutation));
+		_mm256_storeu_si256((__m256i*)right, _mm256_permutevar8x32_epi32(values, rightPermutation));
+		left += COMPRESS_TABLE.counts[leftMask];
+		right += COMPRESS_TABLE.counts[rightMask];
+	}
+	compressPartitionScalar(pivotValue, orEqual, p, last, left, right);
+}
+
+TARGET_AVX512
+void compressPartitionAvx512(int pivotValue, bool orEqual, const int* first, const int* last, int*& left, int*& right) {
+	const __m512i pivot = _mm512_set1_epi32(pivotValue);
+	const int* p = first;
+	for (; last - p >= 16; p += 16) {
+		__m512i values = _mm512_loadu_si512((const void*)p);
+		__mmask16 leftMask = orEqual
+			? _mm512_cmple_epi32_mask(values, pivot)
+			: _mm512_cmplt_epi32_mask(values, pivot);
+		__mmask16 rightMask = (__mmask16)~leftMask;
+		_mm512_mask_compressstoreu_epi32(left, leftMask, values);
+		_mm512_mask_compressstoreu_epi32(right, rightMask, values);
+		left += COMPRESS_TABLE.counts[leftMask & 0xFF] + COMPRESS_TABLE.counts[leftMask >> 8];
+		right += COMPRESS_TABLE.counts[rightMask & 0xFF] + COMPRESS_TABLE.counts[rightMask >> 8];
+	}
+	compressPartitionScalar(pivotValue, orEqual, p, last, left, right);
+}
+#endif
+
+// Stable partition of arr[start..end]: values < pivotValue (<= when orEqual) are packed to the
+// front and the rest follow, both in their original order. The left side is compacted in place
+// and the right side goes through the scratch buffer.
+//
+// Returns: How many values went to the left.
+int compressPartition(SimdLevel level, int pivotValue, bool orEqual, int arr[], int start, int end) {
+	int n = (end + 1) - start;
+	int* scratch = partitionScratch(n);
+	int* left = arr + start;
+	int* right = scratch;
+
+	switch (level) {
+#ifdef HAS_X86_SIMD
+	case SimdLevel::Avx512:
+		compressPartitionAvx512(pivotValue, orEqual, arr + start, arr + end + 1, left, right);
+		break;
+	case SimdLevel::Avx2:
+		compressPartitionAvx2(pivotValue, orEqual, arr + start, arr + end + 1, left, right);
+		break;
+#endif
+	default:
+		compressPartitionScalar(pivotValue, orEqual, arr + start, arr + end + 1, left, right);
+		break;
+	}
+
+	memcpy(left, scratch, (right - scratch) * sizeof(int));
+	return (int)(left - (arr + start));
+}
+
+// Vectorized counterpart of partitionThreeWay() with the same contract: one pass splits off the
+// values below the pivot and a second pass over the rest splits the equal keys from the greater.
+EqualRange partitionThreeWaySimd(SimdLevel level, int pivotIndex, int arr[], int start, int end) {
+	assert((end + 1) - start != 0 && pivotIndex >= start && pivotIndex <= end);
+
+	int pivotValue = arr[pivotIndex];
+	int lt = start + compressPartition(level, pivotValue, false, arr, start, end);
+	int gt = lt + compressPartition(level, pivotValue, true, arr, lt, end);
+	return { lt, gt };
+}
+
+// Vectorized counterpart of partition() with the same contract. It is built on the three-way
+// kernel and returns the middle of the keys equal to the pivot, so like partition() it splits
+// runs of duplicates evenly instead of leaving them all on one side.
+int partitionSimd(SimdLevel level, int pivotIndex, int arr[], int start, int end) {
+	EqualRange equal = partitionThreeWaySimd(level, pivotIndex, arr, start, end);
+	return equal.lt + (equal.gt - equal.lt - 1) / 2;
+}
+
+// Quickly finds the k-th smallest value without sorting the entire array.
+//
+// This is an iterative introselect: median-of-three pivots are used while each partition makes
+// good progress, and if MAX_BAD_PARTITIONS partitions in a row fail to shrink the live range to
+// 3/4 of its size the next pivot is chosen with median-of-medians. That bounds the worst case at
+// O(n) and the stack depth at O(log n). On return arr[k] holds its sorted value, everything
+// before it is less or equal and everything after it is greater or equal.
+//
+// Subranges of at least SIMD_PARTITION_THRESHOLD values are partitioned with the AVX2/AVX-512
+// kernels when the CPU has them.
+//
+// k: 0 based index k into array arr
+// arr: mutable pointer to an array
+// start: start index of the array
+// end: end index of the array
+// mode: two-way or three-way partitioning, see PartitionMode
+int findKthSmallestValue(int k, int arr[], int start, int end, PartitionMode mode) {
+	int n = (end + 1) - start;
+	if (n <= 0 || k < start || k > end) {
+		throw runtime_error("Invalid input.");
+	}
+
+	PartitionScratchScope scratchScope;
+	int badPartitions = 0;
+	while ((end + 1) - start > INSERTION_SORT_THRESHOLD) {
+		int size = (end + 1) - start;
+
+		int chosenPivotIndex = badPartitions >= MAX_BAD_PARTITIONS
+			? chooseMedianOfMediansPivotIndex(arr, start, end)
+			: chooseMedianOfThreePivotIndex(arr, start, end);
+
+		SimdLevel level = size >= SIMD_PARTITION_THRESHOLD ? simdLevel() : SimdLevel::Scalar;
+
+		if (mode == PartitionMode::ThreeWay) {
+			// Done as soon as k lands on a key equal to the pivot.
+			EqualRange equal = level != SimdLevel::Scalar
+				? partitionThreeWaySimd(level, chosenPivotIndex, arr, start, end)
+				: partitionThreeWay(chosenPivotIndex, arr, start, end);
+			if (k >= equal.lt && k < equal.gt) {
+				return arr[k];
+			}
+
+			if (k < equal.lt) {
+				end = equal.lt - 1;
+			}
+			else {
+				start = equal.gt;
+			}
+		}
+		else {
+			int pivotIndex = level != SimdLevel::Scalar
+				? partitionSimd(level, chosenPivotIndex, arr, start, end)
+				: partition(chosenPivotIndex, arr, start, end);
+
+			if (pivotIndex == k) {
+				return arr[pivotIndex];
+			}
+
+			// Note that the pivot is not included in s1 or s2. This guarantees that the problem reduces.
+			if (pivotIndex > k) {
+				end = pivotIndex - 1;
+			}
+			else {
+				start = pivotIndex + 1;
+			}
+		}
+
+		if (4 * (long long)((end + 1) - start) > 3 * (long long)size) {
+			badPartitions += 1;
+		}
+		else {
+			badPartitions = 0;
+		}
+	}
+
+	insertionSort(arr, start, end);
+	return arr[k];
+}
+
+// A subrange of the array together with the slice [firstRank, lastRank) of the sorted requested
+// ranks that fall inside it. Used as the explicit work stack of findKthSmallestValues.
+struct SelectionSegment {
+	int start;
+	int end;
+	size_t firstRank;
+	size_t lastRank;
+};
+
+// Finds several order statistics at once, e.g. the p50/p90/p99/p999 of a sample buffer.
+//
+// The median requested rank is selected first, which leaves the array partitioned around it, and
+// then only the two sides that still hold requested ranks are processed. Every level of that rank
+// recursion touches disjoint parts of the array, so the total work is O(n log m) for m ranks
+// instead of O(n * m) for m separate findKthSmallestValue calls.
+//
+// ks: 0 based indices into arr, in any order and possibly repeated
+// nk: number of entries in ks and results
+// arr: mutable pointer to an array
+// start: start index of the array
+// end: end index of the array
+// results: receives the value for ks[i] in results[i]
+// mode: two-way or three-way partitioning, see PartitionMode
+void findKthSmallestValues(const int* ks, size_t nk, int arr[], int start, int end, int results[],
+	PartitionMode mode = PartitionMode::ThreeWay) {
+	if ((end + 1) - start <= 0) {
+		throw runtime_error("Invalid input.");
+	}
+	if (nk == 0) {
+		return;
+	}
+
+	// Work on the ranks in sorted order but remember where each one came from.
+	vector<size_t> order(nk);
+	for (size_t i = 0; i < nk; ++i) {
+		if (ks[i] < start || ks[i] > end) {
+			throw runtime_error("Invalid input.");
+		}
+		order[i] = i;
+	}
+	sort(order.begin(), order.end(), [ks](size_t a, size_t b) { return ks[a] < ks[b]; });
+
+	vector<SelectionSegment> segments;
+	segments.push_back({ start, end, 0, nk });
+	while (!segments.empty()) {
+		SelectionSegment segment = segments.back();
+		segments.pop_back();
+
+		size_t midRank = segment.firstRank + (segment.lastRank - segment.firstRank) / 2;
+		int k = ks[order[midRank]];
+		int value = findKthSmallestValue(k, arr, segment.start, segment.end, mode);
+
+		// Repeated ranks all get the same answer, so widen [lowRank, highRank) over them.
+		size_t lowRank = midRank;
+		while (lowRank > segment.firstRank && ks[order[lowRank - 1]] == k) {
+			lowRank -= 1;
+		}
+		size_t highRank = midRank + 1;
+		while (highRank < segment.lastRank && ks[order[highRank]] == k) {
+			highRank += 1;
+		}
+		for (size_t r = lowRank; r < highRank; ++r) {
+			results[order[r]] = value;
+		}
+
+		if (lowRank > segment.firstRank) {
+			segments.push_back({ segment.start, k - 1, segment.firstRank, lowRank });
+		}
+		if (highRank < segment.lastRank) {
+			segments.push_back({ k + 1, segment.end, highRank, segment.lastRank });
+		}
+	}
+}
+
+// Runs work(0) .. work(threadCount - 1) concurrently, using the calling thread for the last one.
+template<typename Work>
+void runOnThreads(unsigned threadCount, Work work) {
+	vector<thread> threads;
+	for (unsigned t = 0; t + 1 < threadCount; ++t) {
+		threads.emplace_back(work, t);
+	}
+	work(threadCount - 1);
+	for (thread& worker : threads) {
+		worker.join();
+	}
+}
+
+// Median of PIVOT_SAMPLE_SIZE values spread evenly over arr[start..end].
+int choosePivotValueFromSample(const int arr[], int start, int end) {
+	int sample[PIVOT_SAMPLE_SIZE];
+	long long n = (long long)(end + 1) - start;
+	for (int i = 0; i < PIVOT_SAMPLE_SIZE; ++i) {
+		sample[i] = arr[start + (int)(n * i / PIVOT_SAMPLE_SIZE)];
+	}
+	insertionSort(sample, 0, PIVOT_SAMPLE_SIZE - 1);
+	return sample[PIVOT_SAMPLE_SIZE / 2];
+}
+
+// How many values of one thread's block are below and equal to the pivot.
+struct BlockCounts {
+	int less;
+	int equal;
+};
+
+// Reusable barrier for a fixed set of threads; std::barrier needs C++20.
+class ThreadBarrier {
+private:
+	mutex lock;
+	condition_variable released;
+	unsigned threadCount;
+	unsigned waiting;
+	unsigned long long generation;
+public:
+	explicit ThreadBarrier(unsigned threadCount) : threadCount(threadCount), waiting(0), generation(0) {}
+
+	void arriveAndWait() {
+		unique_lock<mutex> guard(lock);
+		unsigned long long arrivedIn = generation;
+		if (++waiting == threadCount) {
+			waiting = 0;
+			generation += 1;
+			released.notify_all();
+		}
+		else {
+			released.wait(guard, [&] { return generation != arrivedIn; });
+		}
+	}
+};
+
+// Parallel selection for very large arrays. The worker threads are started once and step through
+// rounds together, separated by barriers. Each round splits the live range into one block per
+// thread; the threads count the values below, equal to and above a sampled pivot in their block,
+// a prefix sum over those counts gives every block its output offsets, and the blocks are then
+// compacted in parallel through a scratch buffer and copied back. Once the live range is below
+// PARALLEL_SELECTION_THRESHOLD, or the sampled pivots stop making progress, the serial
+// findKthSmallestValue finishes the job. Leaves arr partitioned around k like findKthSmallestValue.
+//
+// k: 0 based index k into array arr
+// arr: mutable pointer to an array
+// start: start index of the array
+// end: end index of the array
+// threadCount: number of threads to use, 0 picks one per hardware thread
+int findKthSmallestValueParallel(int k, int arr[], int start, int end, unsigned threadCount) {
+	int n = (end + 1) - start;
+	if (n <= 0 || k < start || k > end) {
+		throw runtime_error("Invalid input.");
+	}
+	if (threadCount == 0) {
+		threadCount = max(1u, thread::hardware_concurrency());
+	}
+	if (threadCount == 1 || n <= PARALLEL_SELECTION_THRESHOLD) {
+		return findKthSmallestValue(k, arr, start, end);
+	}
+
+	// Round state, only changed by thread 0 while the others wait at a barrier.
+	bool done = false;
+	bool found = false;
+	int badRounds = 0;
+	int size = n;
+	int blockSize = (size + (int)threadCount - 1) / (int)threadCount;
+	int pivotValue = choosePivotValueFromSample(arr, start, end);
+
+	vector<int> scratch(n);
+	vector<BlockCounts> counts(threadCount);
+	ThreadBarrier barrier(threadCount);
+
+	runOnThreads(threadCount, [&](unsigned t) {
+		while (!done) {
+			int blockStart = start + min(size, (int)t * blockSize);
+			int blockEnd = start + min(size, ((int)t + 1) * blockSize);
+			BlockCounts blockCounts = { 0, 0 };
+			for (int i = blockStart; i < blockEnd; ++i) {
+				blockCounts.less += arr[i] < pivotValue;
+				blockCounts.equal += arr[i] == pivotValue;
+			}
+			counts[t] = blockCounts;
+			barrier.arriveAndWait();
+
+			// Where this block's values go: after everything earlier blocks put in the same segment.
+			int totalLess = 0;
+			int totalEqual = 0;
+			for (const BlockCounts& other : counts) {
+				totalLess += other.less;
+				totalEqual += other.equal;
+			}
+			int offsets[3] = { 0, totalLess, totalLess + totalEqual };
+			for (unsigned before = 0; before < t; ++before) {
+				int blockLength = min(size, ((int)before + 1) * blockSize) - min(size, (int)before * blockSize);
+				offsets[0] += counts[before].less;
+				offsets[1] += counts[before].equal;
+				offsets[2] += blockLength - counts[before].less - counts[before].equal;
+			}
+
+			// 0, 1 or 2 for below, equal to or above the pivot, so the write needs no branch.
+			for (int i = blockStart; i < blockEnd; ++i) {
+				int value = arr[i];
+				int segment = (value > pivotValue) + (value >= pivotValue);
+				scratch[offsets[segment]++] = value;
+			}
+			barrier.arriveAndWait();
+
+			if (blockStart < blockEnd) {
+				memcpy(arr + blockStart, scratch.data() + (blockStart - start), (blockEnd - blockStart) * sizeof(int));
+			}
+			barrier.arriveAndWait();
+
+			if (t == 0) {
+				int lt = start + totalLess;
+				int gt = lt + totalEqual;
+				if (k >= lt && k < gt) {
+					found = true;
+				}
+				else if (k < lt) {
+					end = lt - 1;
+				}
+				else {
+					start = gt;
+				}
+
+				int newSize = (end + 1) - start;
+				badRounds = 4 * (long long)newSize > 3 * (long long)size ? badRounds + 1 : 0;
+				done = found || newSize <= PARALLEL_SELECTION_THRESHOLD || badRounds >= MAX_BAD_PARTITIONS;
+				size = newSize;
+				blockSize = (size + (int)threadCount - 1) / (int)threadCount;
+				if (!done) {
+					pivotValue = choosePivotValueFromSample(arr, start, end);
+				}
+			}
+			barrier.arriveAndWait();
+		}
+	});
+
+	if (found) {
+		return arr[k];
+	}
+	return findKthSmallestValue(k, arr, start, end);
+}
+
+// Read-only memory mapping of a raw binary file of int32 values. The values are used in place,
+// which assumes a little-endian host like every x86/x64 target this project builds for.
+class MappedIntFile {
+private:
+	const int* values;
+	size_t count;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	size_t byteLength;
+#endif
+public:
+	explicit MappedIntFile(const string& path) : values(nullptr), count(0) {
+#ifdef _WIN32
+		mapping = nullptr;
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw runtime_error("Could not open " + path);
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			throw runtime_error("Could not stat " + path);
+		}
+		if (fileSize.QuadPart % sizeof(int32_t) != 0) {
+			CloseHandle(file);
+			throw runtime_error(path + " is not a whole number of int32 values");
+		}
+		count = (size_t)(fileSize.QuadPart / sizeof(int));
+		if (count > 0) {
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			values = mapping ? (const int*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			if (values == nullptr) {
+				if (mapping) {
+					CloseHandle(mapping);
+				}
+				CloseHandle(file);
+				throw runtime_error("Could not map " + path);
+			}
+		}
+#else
+		int descriptor = open(path.c_str(), O_RDONLY);
+		if (descriptor < 0) {
+			throw runtime_error("Could not open " + path);
+		}
+		struct stat info;
+		if (fstat(descriptor, &info) != 0) {
+			close(descriptor);
+			throw runtime_error("Could not stat " + path);
+		}
+		byteLength = (size_t)info.st_size;
+		if (byteLength % sizeof(int32_t) != 0) {
+			close(descriptor);
+			throw runtime_error(path + " is not a whole number of int32 values");
+		}
+		count = byteLength / sizeof(int);
+		if (count > 0) {
+			void* address = mmap(nullptr, byteLength, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			if (address == MAP_FAILED) {
+				close(descriptor);
+				throw runtime_error("Could not map " + path);
+			}
+			// The passes below read front to back, so ask for aggressive read-ahead.
+			madvise(address, byteLength, MADV_SEQUENTIAL);
+			values = (const int*)address;
+		}
+		close(descriptor);
+#endif
+	}
+
+	~MappedIntFile() {
+#ifdef _WIN32
+		if (values) {
+			UnmapViewOfFile(values);
+		}
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+#else
+		if (values) {
+			munmap((void*)values, byteLength);
+		}
+#endif
+	}
+
+	MappedIntFile(const MappedIntFile&) = delete;
+	MappedIntFile& operator=(const MappedIntFile&) = delete;
+
+	const int* getValues() const {
+		return values;
+	}
+
+	size_t getCount() const {
+		return count;
+	}
+};
+
+// Flips the sign bit so that unsigned order of the keys matches signed order of the values.
+unsigned orderedKey(int value) {
+	return (unsigned)value ^ 0x80000000u;
+}
+
+// Finds the bucket of a histogram holding rank k.
+//
+// Returns: The bucket index; rank is rebased to a rank inside that bucket.
+size_t findBucketOfRank(const vector<long long>& histogram, long long& rank) {
+	size_t bucket = 0;
+	while (rank >= histogram[bucket]) {
+		rank -= histogram[bucket];
+		bucket += 1;
+	}
+	return bucket;
+}
+
+// Finds the k-th smallest value of a raw little-endian int32 file without loading it, for
+// datasets larger than RAM. The file is mapped read-only and never modified.
+//
+// A first sequential pass histograms the top HISTOGRAM_BITS bits of every value to find the
+// bucket holding rank k. If that bucket has at most maxBucketValues values, a second pass copies
+// just those into memory and findKthSmallestValue finishes there. Otherwise a second histogram
+// over the low bits of that bucket's values pins down the answer directly. Either way it is two
+// passes and memory stays bounded by the histogram plus maxBucketValues ints.
+//
+// k: 0 based rank into the values of the file
+// path: file of little-endian int32 values
+// maxBucketValues: most values the second pass may copy into memory
+int findKthSmallestValueInFile(long long k, const string& path, size_t maxBucketValues = DEFAULT_MAX_BUCKET_VALUES) {
+	MappedIntFile file(path);
+	const int* values = file.getValues();
+	size_t n = file.getCount();
+	if (k < 0 || (size_t)k >= n) {
+		throw runtime_error("Invalid input.");
+	}
+
+	const int lowBits = 32 - HISTOGRAM_BITS;
+	vector<long long> histogram((size_t)1 << HISTOGRAM_BITS, 0);
+	for (size_t i = 0; i < n; ++i) {
+		histogram[orderedKey(values[i]) >> lowBits] += 1;
+	}
+	long long rank = k;
+	unsigned highBucket = (unsigned)findBucketOfRank(histogram, rank);
+
+	if ((size_t)histogram[highBucket] <= maxBucketValues) {
+		vector<int> bucket;
+		bucket.reserve((size_t)histogram[highBucket]);
+		for (size_t i = 0; i < n; ++i) {
+			if (orderedKey(values[i]) >> lowBits == highBucket) {
+				bucket.push_back(values[i]);
+			}
+		}
+		return findKthSmallestValue((int)rank, bucket.data(), 0, (int)bucket.size() - 1);
+	}
+
+	// Too many values share the high bits to hold them, but then the low bits are all that's left.
+	vector<long long> lowHistogram((size_t)1 << lowBits, 0);
+	for (size_t i = 0; i < n; ++i) {
+		unsigned key = orderedKey(values[i]);
+		if (key >> lowBits == highBucket) {
+			lowHistogram[key & ((1u << lowBits) - 1)] += 1;
+		}
+	}
+	unsigned lowBucket = (unsigned)findBucketOfRank(lowHistogram, rank);
+	return (int)(((highBucket << lowBits) | lowBucket) ^ 0x80000000u);
+}
+
+// KLL streaming quantile sketch for approximate percentiles over unbounded streams.
+//
+// Values go into a stack of compactors where an item at level h stands for 2^h inserted values.
+// When a level fills up it is sorted and every other item (starting at a random offset) is
+// promoted, halving it. Lower levels get geometrically smaller capacities, so the sketch keeps
+// O(k) items and the rank error is about n / k with high probability. Two sketches merge by
+// concatenating their levels and compacting, which costs O(k) however many values they have seen,
+// so per-thread sketches can be combined cheaply.
+class KllSketch {
+private:
+	int k;
+	long long count;
+	size_t retained;
+	size_t maxRetained;
+	vector<vector<int>> compactors;
+	unsigned long long randomState;
+
+	// Capacity of a level: k at the top, shrinking by 2/3 per level down, never below 2.
+	size_t capacity(size_t level) const {
+		size_t depth = compactors.size() - level - 1;
+		double scaled = k;
+		for (size_t i = 0; i < depth; ++i) {
+			scaled *= 2.0 / 3.0;
+		}
+		return max((size_t)2, (size_t)scaled + 1);
+	}
+
+	void grow() {
+		compactors.emplace_back();
+		maxRetained = 0;
+		for (size_t level = 0; level < compactors.size(); ++level) {
+			maxRetained += capacity(level);
+		}
+	}
+
+	// xorshift64, one bit per compaction. Each sketch has its own state so threads never share it.
+	bool coinFlip() {
+		randomState ^= randomState << 13;
+		randomState ^= randomState >> 7;
+		randomState ^= randomState << 17;
+		return (randomState & 1) != 0;
+	}
+
+	void compress() {
+		for (size_t level = 0; level < compactors.size(); ++level) {
+			if (compactors[level].size() < capacity(level)) {
+				continue;
+			}
+			if (level + 1 == compactors.size()) {
+				grow();
+			}
+
+			vector<int>& items = compactors[level];
+			sort(items.begin(), items.end());
+			size_t keep = items.size() % 2; // An odd item out stays behind.
+			for (size_t i = keep + (coinFlip() ? 1 : 0); i < items.size(); i += 2) {
+				compactors[level + 1].push_back(items[i]);
+			}
+			retained -= items.size() - keep - (items.size() - keep) / 2;
+			items.resize(keep);
+
+			if (retained < maxRetained) {
+				break;
+			}
+		}
+	}
+
+	// All retained items with their weights, sorted by value.
+	vector<pair<int, long long>> weightedItems() const {
+		vector<pair<int, long long>> items;
+		items.reserve(retained);
+		for (size_t level = 0; level < compactors.size(); ++level) {
+			for (int value : compactors[level]) {
+				items.emplace_back(value, 1LL << level);
+			}
+		}
+		sort(items.begin(), items.end());
+		return items;
+	}
+
+public:
+	explicit KllSketch(int k = KLL_DEFAULT_K, unsigned long long seed = 0x9E3779B97F4A7C15ULL)
+		: k(k), count(0), retained(0), maxRetained(0), randomState(seed | 1) {
+		if (k < 2) {
+			throw runtime_error("Invalid input.");
+		}
+		grow();
+	}
+
+	void insert(int value) {
+		compactors[0].push_back(value);
+		count += 1;
+		retained += 1;
+		if (retained >= maxRetained) {
+			compress();
+		}
+	}
+
+	// Folds other into this sketch. other is left unchanged.
+	void merge(const KllSketch& other) {
+		while (compactors.size() < other.compactors.size()) {
+			grow();
+		}
+		for (size_t level = 0; level < other.compactors.size(); ++level) {
+			compactors[level].insert(compactors[level].end(), other.compactors[level].begin(), other.compactors[level].end());
+		}
+		count += other.count;
+		retained += other.retained;
+		while (retained >= maxRetained) {
+			compress();
+		}
+	}
+
+	long long getCount() const {
+		return count;
+	}
+
+	size_t getRetainedCount() const {
+		return retained;
+	}
+
+	// Approximate number of inserted values less than value.
+	long long rank(int value) const {
+		long long result = 0;
+		for (size_t level = 0; level < compactors.size(); ++level) {
+			for (int item : compactors[level]) {
+				if (item < value) {
+					result += 1LL << level;
+				}
+			}
+		}
+		return result;
+	}
+
+	// Approximate q-quantile, 0 <= q <= 1, i.e. the value of rank about q * (count - 1).
+	int quantile(double q) const {
+		if (count == 0 || q < 0 || q > 1) {
+			throw runtime_error("Invalid input.");
+		}
+		vector<pair<int, long long>> items = weightedItems();
+		long long target = (long long)(q * (count - 1));
+		long long cumulative = 0;
+		for (const pair<int, long long>& item : items) {
+			cumulative += item.second;
+			if (cumulative > target) {
+				return item.first;
+			}
+		}
+		return items.back().first;
+	}
+};
+
+// xorshift64* generator for pivot sampling. rand() shares one hidden state between all callers,
+// which is not thread-safe and serializes concurrent selections; this is a plain value, so every
+// call or thread can own one.
+class FastRandom {
+private:
+	unsigned long long state;
+public:
+	explicit FastRandom(unsigned long long seed) : state(seed != 0 ? seed : 0x9E3779B97F4A7C15ULL) {}
+
+	unsigned long long next() {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1DULL;
+	}
+
+	// A value in [0, n).
+	size_t below(size_t n) {
+		return (size_t)((next() >> 11) % n);
+	}
+};
+
+// The calling thread's own FastRandom, seeded from its thread id.
+FastRandom& threadRandom() {
+	thread_local FastRandom random(hash<thread::id>()(this_thread::get_id()) * 0x9E3779B97F4A7C15ULL);
+	return random;
+}
+
+// Swap-based insertion sort of [first, last) so it never needs to copy a value.
+template<typename RandomIt, typename Compare>
+void insertionSortRange(RandomIt first, RandomIt last, Compare& comp) {
+	if (last - first < 2) {
+		return;
+	}
+	for (RandomIt i = first + 1; i != last; ++i) {
+		for (RandomIt j = i; j != first && comp(*j, *(j - 1)); --j) {
+			iter_swap(j, j - 1);
+		}
+	}
+}
+
+// Median of three randomly sampled positions of [first, last).
+template<typename RandomIt, typename Compare>
+RandomIt chooseRandomMedianOfThree(RandomIt first, RandomIt last, Compare& comp, FastRandom& random) {
+	size_t n = (size_t)(last - first);
+	RandomIt a = first + random.below(n);
+	RandomIt b = first + random.below(n);
+	RandomIt c = first + random.below(n);
+	if (comp(*a, *b)) {
+		if (comp(*b, *c)) {
+			return b;
+		}
+		return comp(*a, *c) ? c : a;
+	}
+	if (comp(*a, *c)) {
+		return a;
+	}
+	return comp(*b, *c) ? c : b;
+}
+
+template<typename RandomIt, typename Compare>
+void selectKthSmallest(RandomIt first, RandomIt kth, RandomIt last, Compare comp, FastRandom& random);
+
+// Generic median-of-medians, see chooseMedianOfMediansPivotIndex.
+template<typename RandomIt, typename Compare>
+RandomIt chooseMedianOfMedians(RandomIt first, RandomIt last, Compare& comp, FastRandom& random) {
+	RandomIt medians = first;
+	for (RandomIt group = first; group < last; group += min<ptrdiff_t>(5, last - group)) {
+		RandomIt groupEnd = group + min<ptrdiff_t>(5, last - group);
+		insertionSortRange(group, groupEnd, comp);
+		iter_swap(medians, group + (groupEnd - group - 1) / 2);
+		++medians;
+	}
+	RandomIt mid = first + (medians - first - 1) / 2;
+	selectKthSmallest(first, mid, medians, comp, random);
+	return mid;
+}
 
-	// TODO: finish
+// Three-way partition of [first, last) around *pivot for trivially copyable values: the pivot is
+// copied once into a local, which the compiler can keep in a register for the whole loop.
+template<typename RandomIt, typename Compare>
+pair<RandomIt, RandomIt> partitionThreeWayRange(RandomIt first, RandomIt last, RandomIt pivot, Compare& comp, true_type) {
+	const typename iterator_traits<RandomIt>::value_type pivotValue = *pivot;
+	RandomIt lt = first;
+	RandomIt i = first;
+	RandomIt gt = last;
+	while (i < gt) {
+		if (comp(*i, pivotValue)) {
+			iter_swap(lt++, i++);
+		}
+		else if (comp(pivotValue, *i)) {
+			iter_swap(i, --gt);
+		}
+		else {
+			++i;
+		}
+	}
+	return { lt, gt };
+}
 
-	if (arr[start] > arr[end]) {
-		swap(arr[start], arr[end]);
-		if (start == pivotIndex) {
-			pivotIndex = end;
+// Three-way partition for everything else. The pivot is parked at first and compared in place,
+// so no value is ever copied; it is swapped into the middle of the equal keys at the end.
+template<typename RandomIt, typename Compare>
+pair<RandomIt, RandomIt> partitionThreeWayRange(RandomIt first, RandomIt last, RandomIt pivot, Compare& comp, false_type) {
+	iter_swap(first, pivot);
+	RandomIt lt = first + 1;
+	RandomIt i = first + 1;
+	RandomIt gt = last;
+	while (i < gt) {
+		if (comp(*i, *first)) {
+			iter_swap(lt++, i++);
 		}
-		else if (end == pivotIndex) {
-			pivotIndex = start;
+		else if (comp(*first, *i)) {
+			iter_swap(i, --gt);
+		}
+		else {
+			++i;
 		}
 	}
-	
-	if (arr[start] > pivotValue or start == pivotIndex) {
-		return partition(pivotIndex, arr, start, end - 1);
-	}
-	else if (arr[end] < pivotValue or end == pivotIndex) {
-		return partition(pivotIndex, arr, start + 1, end);
-	}
-
-	return partition(pivotIndex, arr, start + 1, end - 1);
+	--lt;
+	iter_swap(first, lt);
+	return { lt, gt };
 }
 
-// Quickly finds the k-th smallest value without sorting the entire array.
+// Generic selection over random-access iterators with the same contract as std::nth_element:
+// afterwards *kth is the value a full sort by comp would put there, nothing before it compares
+// greater and nothing after it compares less. Same introselect scheme as findKthSmallestValue
+// (three-way partitions, median-of-medians fallback, linear worst case), but with randomly sampled
+// median-of-three pivots drawn from the caller's FastRandom instead of rand().
 //
-// k: 0 based index k into array arr
-// arr: mutable pointer to an array
-// start: start index of the array
-// end: end index of the array
-int findKthSmallestValue(int k, int arr[], int start, int end) {
-	int n = (end + 1) - start;
-	if (n == 0) {
+// first, last: the range to select in
+// kth: position in [first, last) to fill
+// comp: strict weak ordering, e.g. less<>() or greater<>()
+// random: pivot sampling state, owned by the caller or the current thread
+template<typename RandomIt, typename Compare>
+void selectKthSmallest(RandomIt first, RandomIt kth, RandomIt last, Compare comp, FastRandom& random) {
+	if (!(first <= kth && kth < last)) {
 		throw runtime_error("Invalid input.");
 	}
+	typedef typename iterator_traits<RandomIt>::value_type Value;
+	typedef integral_constant<bool, is_trivially_copyable<Value>::value && sizeof(Value) <= 4 * sizeof(void*)> CopyPivot;
 
-	// Return the single value in an array of length 1.
-	if (n == 1) {
-		return arr[start];
-	}
-
-	int chosenPivotIndex = chooseRandomPivotIndex(start, end);
-
-	int pivotIndex = partition(chosenPivotIndex, arr, start, end);
+	int badPartitions = 0;
+	while (last - first > INSERTION_SORT_THRESHOLD) {
+		ptrdiff_t size = last - first;
+		RandomIt pivot = badPartitions >= MAX_BAD_PARTITIONS
+			? chooseMedianOfMedians(first, last, comp, random)
+			: chooseRandomMedianOfThree(first, last, comp, random);
 
-	//int s1 = pivotIndex - start;
+		pair<RandomIt, RandomIt> equal = partitionThreeWayRange(first, last, pivot, comp, CopyPivot());
+		if (kth < equal.first) {
+			last = equal.first;
+		}
+		else if (kth >= equal.second) {
+			first = equal.second;
+		}
+		else {
+			return;
+		}
 
-	// Base case where s1 == k (what's the point of s1?).
-	if (pivotIndex == k) {
-		// TODO: Replace -1 with the value for the base case.
-		return arr[pivotIndex];
+		if (4 * (last - first) > 3 * size) {
+			badPartitions += 1;
+		}
+		else {
+			badPartitions = 0;
+		}
 	}
+	insertionSortRange(first, last, comp);
+}
 
-	// Figure out which segment the kth smallest is in and recurse.
-	// Note that the pivot is not included in s1 or s2. This guarantees that the problem reduces while recursing.
-	// TODO: Replace true with a boolean expression that determines which segment to recurse into.
-	if (pivotIndex > k) {
-		// TODO: Replace -1 with a recursive call to findKthSmallestValue.
-		return findKthSmallestValue(k, arr, start, pivotIndex-1);
-	}
-	else {
-		// TODO: Replace -1 with a recursive call to findKthSmallestValue.
-		return findKthSmallestValue(k, arr, pivotIndex+1, end);
-	}
+// selectKthSmallest using the calling thread's FastRandom.
+template<typename RandomIt, typename Compare = less<>>
+void selectKthSmallest(RandomIt first, RandomIt kth, RandomIt last, Compare comp = Compare()) {
+	selectKthSmallest(first, kth, last, comp, threadRandom());
 }
 
 // Used to test our results. Warning: Sorts the input array in place.
 int findKthSmallestValueViaSorting(int k, int arr[], int start, int end) {
 	int n = (end + 1) - start;
-	if (n == 0 || k >= n) {
+	if (n == 0 || k < start || k > end) {
 		throw runtime_error("Invalid input.");
 	}
 
@@ -121,7 +1250,7 @@ int findKthSmallestValueViaSorting(int k, int arr[], int start, int end) {
 		return arr[start];
 	}
 
-	sort(arr, arr + n);
+	sort(arr + start, arr + end + 1);
 
 	return arr[k];
 }
@@ -160,6 +1289,28 @@ void testFindKthSmallestValueForArraySizeN(int n) {
 		}
 	}
 
+	// Check every k again, this time in a single batched call.
+	int* ks = new int[n];
+	for (int k = 0; k < n; ++k) {
+		ks[k] = n - 1 - k; // Deliberately out of order
+	}
+	int* results = new int[n];
+	int* copyArray3 = copyArray(arr, n);
+	findKthSmallestValues(ks, n, copyArray3, 0, n - 1, results);
+	delete[] copyArray3;
+
+	int* sorted = copyArray(arr, n);
+	sort(sorted, sorted + n);
+	for (int i = 0; i < n; ++i) {
+		if (results[i] != sorted[ks[i]]) {
+			throw runtime_error("Test failed.");
+		}
+	}
+	cout << "Success for batched input array of size " << n << endl;
+
+	delete[] sorted;
+	delete[] results;
+	delete[] ks;
 	delete[] arr;
 }
 
@@ -175,6 +1326,114 @@ void testFindKthSmallestValue(int repetitions, int maxArraySize) {
 	}
 }
 
+// rand() only covers 15 bits on some platforms, so combine two calls to cover the int range.
+int randomWideInt() {
+	return (int)(((unsigned)rand() << 16) ^ (unsigned)rand());
+}
+
+// Fills arr with one of several input shapes, including ones that defeat naive pivot choices.
+void fillTestPattern(int pattern, int arr[], int n) {
+	for (int i = 0; i < n; ++i) {
+		switch (pattern) {
+		case 0: arr[i] = randomWideInt(); break;         // Wide random values
+		case 1: arr[i] = rand() % 100; break;            // Many duplicates
+		case 2: arr[i] = i; break;                       // Sorted
+		case 3: arr[i] = n - i; break;                   // Reversed
+		case 4: arr[i] = 7; break;                       // All equal
+		case 5: arr[i] = i < n / 2 ? i : n - i; break;   // Organ pipe
+		default: arr[i] = i % 16; break;                 // Sawtooth
+		}
+	}
+}
+
+#define TEST_PATTERN_COUNT 7
+
+// Tests findKthSmallestValue against findKthSmallestValueViaSorting for array sizes growing by
+// powers of ten up to maxArraySize. main runs it up to 1000000; pass --large to also run
+// 100000000, which needs about 1.2 GB of memory.
+void testFindKthSmallestValueLargeArrays(int maxArraySize) {
+	for (long long n = 10; n <= maxArraySize; n *= 10) {
+		int size = (int)n;
+		int* arr = new int[size];
+		for (int pattern = 0; pattern < TEST_PATTERN_COUNT; ++pattern) {
+			fillTestPattern(pattern, arr, size);
+
+			int* sorted = copyArray(arr, size);
+			int ks[] = { 0, size / 4, size / 2, size - 1, rand() % size };
+			for (int k : ks) {
+				int expectedResult = findKthSmallestValueViaSorting(k, sorted, 0, size - 1);
+
+				for (PartitionMode mode : { PartitionMode::TwoWay, PartitionMode::ThreeWay }) {
+					int* copy = copyArray(arr, size);
+					int result = findKthSmallestValue(k, copy, 0, size - 1, mode);
+					delete[] copy;
+
+					if (result != expectedResult) {
+						throw runtime_error("Test failed.");
+					}
+				}
+			}
+
+			// The same ranks again as one batch, plus the usual latency percentiles.
+			int batchKs[] = { ks[0], ks[1], ks[2], ks[3], ks[4], size / 2, size * 9 / 10, (int)(size * 0.99), (int)(size * 0.999) };
+			const size_t batchSize = sizeof(batchKs) / sizeof(batchKs[0]);
+			int batchResults[batchSize];
+			int* copy = copyArray(arr, size);
+			findKthSmallestValues(batchKs, batchSize, copy, 0, size - 1, batchResults);
+			delete[] copy;
+			for (size_t i = 0; i < batchSize; ++i) {
+				if (batchResults[i] != findKthSmallestValueViaSorting(batchKs[i], sorted, 0, size - 1)) {
+					throw runtime_error("Test failed.");
+				}
+			}
+			delete[] sorted;
+		}
+		delete[] arr;
+		cout << "Success for large input arrays of size " << size << endl;
+	}
+}
+
+// Times median selection with both partition modes on arrays of length n whose values are drawn
+// from a shrinking number of distinct keys.
+void partitionModeBigO(int n) {
+	const int cardinalities[] = { 2, 16, 100, 10000, n };
+	int* arr = new int[n];
+	for (int cardinality : cardinalities) {
+		for (int i = 0; i < n; ++i) {
+			arr[i] = (int)((unsigned)randomWideInt() % (unsigned)cardinality);
+		}
+
+		cout << "cardinality " << cardinality << ":";
+		for (PartitionMode mode : { PartitionMode::TwoWay, PartitionMode::ThreeWay }) {
+			int* copy = copyArray(arr, n);
+			auto begin = chrono::steady_clock::now();
+			findKthSmallestValue(n / 2, copy, 0, n - 1, mode);
+			auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - begin);
+			delete[] copy;
+
+			cout << (mode == PartitionMode::TwoWay ? " two-way " : " three-way ") << elapsed.count() << " ms";
+		}
+		cout << endl;
+	}
+	delete[] arr;
+}
+
+// Times median selection on an array of length n with 1 to maxThreads threads.
+void parallelSelectionBigO(int n, unsigned maxThreads) {
+	int* arr = new int[n];
+	fillTestPattern(0, arr, n);
+	for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+		int* copy = copyArray(arr, n);
+		auto begin = chrono::steady_clock::now();
+		findKthSmallestValueParallel(n / 2, copy, 0, n - 1, threads);
+		auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - begin);
+		delete[] copy;
+
+		cout << "parallel selection with " << threads << " threads: " << elapsed.count() << " ms" << endl;
+	}
+	delete[] arr;
+}
+
 int factorial(int n) {
 	if (n == 1) {
 		return 1;
@@ -191,6 +1450,222 @@ int fibonacci(int n) {
 	return fibonacci(n - 1) + fibonacci(n - 2);
 }
 
+// Every Fibonacci number that fits in an unsigned 64 bit integer, computed at compile time.
+struct FibonacciTable {
+	unsigned long long values[FIBONACCI_TABLE_SIZE];
+
+	constexpr FibonacciTable() : values() {
+		values[1] = 1;
+		for (int i = 2; i < FIBONACCI_TABLE_SIZE; ++i) {
+			values[i] = values[i - 1] + values[i - 2];
+		}
+	}
+};
+
+// Every factorial that fits in an unsigned 64 bit integer, computed at compile time.
+struct FactorialTable {
+	unsigned long long values[FACTORIAL_TABLE_SIZE];
+
+	constexpr FactorialTable() : values() {
+		values[0] = 1;
+		for (int i = 1; i < FACTORIAL_TABLE_SIZE; ++i) {
+			values[i] = values[i - 1] * i;
+		}
+	}
+};
+
+constexpr FibonacciTable FIBONACCI_TABLE;
+constexpr FactorialTable FACTORIAL_TABLE;
+
+static_assert(FIBONACCI_TABLE.values[93] == 12200160415121876738ULL, "F(93) must be exact");
+static_assert(FACTORIAL_TABLE.values[20] == 2432902008176640000ULL, "20! must be exact");
+
+// O(1) Fibonacci for every n whose value fits in 64 bits.
+unsigned long long fibonacciFast(int n) {
+	if (n < 0 || n >= FIBONACCI_TABLE_SIZE) {
+		throw overflow_error("Fibonacci number does not fit in 64 bits.");
+	}
+	return FIBONACCI_TABLE.values[n];
+}
+
+// O(1) factorial for every n whose value fits in 64 bits.
+unsigned long long factorialFast(int n) {
+	if (n < 0 || n >= FACTORIAL_TABLE_SIZE) {
+		throw overflow_error("Factorial does not fit in 64 bits.");
+	}
+	return FACTORIAL_TABLE.values[n];
+}
+
+// F(n) mod m in O(log n) by fast doubling:
+//     F(2k) = F(k) * (2 F(k+1) - F(k))
+//     F(2k+1) = F(k)^2 + F(k+1)^2
+// m is at most 2^32, so every value is below 2^32 and each product fits in 64 bits. Squares
+// are reduced before they are added, since their sum could pass 2^64.
+unsigned long long fibonacciMod(unsigned long long n, unsigned long long m) {
+	if (m == 0 || m > (1ULL << 32)) {
+		throw runtime_error("Invalid input.");
+	}
+	unsigned long long a = 0;     // F(k)
+	unsigned long long b = 1 % m; // F(k+1)
+	for (int bit = 63; bit >= 0; --bit) {
+		unsigned long long c = a * ((2 * b + m - a) % m) % m;
+		unsigned long long d = (a * a % m + b * b % m) % m;
+		if ((n >> bit) & 1) {
+			a = d;
+			b = (c + d) % m;
+		}
+		else {
+			a = c;
+			b = d;
+		}
+	}
+	return a;
+}
+
+// n! mod m, with the same 2^32 limit on m as fibonacciMod.
+unsigned long long factorialMod(unsigned long long n, unsigned long long m) {
+	if (m == 0 || m > (1ULL << 32)) {
+		throw runtime_error("Invalid input.");
+	}
+	unsigned long long result = 1 % m;
+	for (unsigned long long i = 2; i <= n && result != 0; ++i) {
+		result = result * (i % m) % m;
+	}
+	return result;
+}
+
+// Arbitrary-precision unsigned integer for results past 64 bits. Stored as little-endian base
+// 2^32 limbs with no leading zero limbs, so zero is an empty vector.
+class BigUnsigned {
+private:
+	vector<uint32_t> limbs;
+
+	void trim() {
+		while (!limbs.empty() && limbs.back() == 0) {
+			limbs.pop_back();
+		}
+	}
+public:
+	BigUnsigned(unsigned long long value = 0) {
+		while (value != 0) {
+			limbs.push_back((uint32_t)value);
+			value >>= 32;
+		}
+	}
+
+	bool operator==(const BigUnsigned& other) const {
+		return limbs == other.limbs;
+	}
+
+	BigUnsigned operator+(const BigUnsigned& other) const {
+		BigUnsigned result;
+		size_t n = max(limbs.size(), other.limbs.size());
+		result.limbs.resize(n + 1);
+		unsigned long long carry = 0;
+		for (size_t i = 0; i < n; ++i) {
+			carry += (i < limbs.size() ? limbs[i] : 0ULL) + (i < other.limbs.size() ? other.limbs[i] : 0ULL);
+			result.limbs[i] = (uint32_t)carry;
+			carry >>= 32;
+		}
+		result.limbs[n] = (uint32_t)carry;
+		result.trim();
+		return result;
+	}
+
+	// Requires *this >= other.
+	BigUnsigned operator-(const BigUnsigned& other) const {
+		BigUnsigned result = *this;
+		long long borrow = 0;
+		for (size_t i = 0; i < result.limbs.size(); ++i) {
+			long long difference = (long long)result.limbs[i] - (i < other.limbs.size() ? other.limbs[i] : 0) - borrow;
+			borrow = difference < 0 ? 1 : 0;
+			result.limbs[i] = (uint32_t)(difference + (borrow << 32));
+		}
+		assert(borrow == 0);
+		result.trim();
+		return result;
+	}
+
+	BigUnsigned operator*(const BigUnsigned& other) const {
+		BigUnsigned result;
+		if (limbs.empty() || other.limbs.empty()) {
+			return result;
+		}
+		result.limbs.assign(limbs.size() + other.limbs.size(), 0);
+		for (size_t i = 0; i < limbs.size(); ++i) {
+			unsigned long long carry = 0;
+			for (size_t j = 0; j < other.limbs.size(); ++j) {
+				carry += (unsigned long long)limbs[i] * other.limbs[j] + result.limbs[i + j];
+				result.limbs[i + j] = (uint32_t)carry;
+				carry >>= 32;
+			}
+			result.limbs[i + other.limbs.size()] = (uint32_t)carry;
+		}
+		result.trim();
+		return result;
+	}
+
+	string toString() const {
+		if (limbs.empty()) {
+			return "0";
+		}
+		// Peel off base 10^9 chunks from the least significant end.
+		vector<uint32_t> remaining = limbs;
+		string digits;
+		while (!remaining.empty()) {
+			unsigned long long remainder = 0;
+			for (size_t i = remaining.size(); i-- > 0;) {
+				unsigned long long current = (remainder << 32) | remaining[i];
+				remaining[i] = (uint32_t)(current / 1000000000);
+				remainder = current % 1000000000;
+			}
+			while (!remaining.empty() && remaining.back() == 0) {
+				remaining.pop_back();
+			}
+			for (int i = 0; i < 9 && (!remaining.empty() || remainder != 0); ++i) {
+				digits += (char)('0' + remainder % 10);
+				remainder /= 10;
+			}
+		}
+		reverse(digits.begin(), digits.end());
+		return digits;
+	}
+};
+
+// Exact F(n) for any n by fast doubling, O(log n) big-integer multiplications.
+BigUnsigned fibonacciBig(unsigned long long n) {
+	if (n < FIBONACCI_TABLE_SIZE) {
+		return BigUnsigned(FIBONACCI_TABLE.values[n]);
+	}
+	BigUnsigned a = 0; // F(k)
+	BigUnsigned b = 1; // F(k+1)
+	for (int bit = 63; bit >= 0; --bit) {
+		BigUnsigned c = a * (b + b - a);
+		BigUnsigned d = a * a + b * b;
+		if ((n >> bit) & 1) {
+			a = d;
+			b = c + d;
+		}
+		else {
+			a = c;
+			b = d;
+		}
+	}
+	return a;
+}
+
+// Exact n! for any n.
+BigUnsigned factorialBig(unsigned n) {
+	if (n < FACTORIAL_TABLE_SIZE) {
+		return BigUnsigned(FACTORIAL_TABLE.values[n]);
+	}
+	BigUnsigned result = FACTORIAL_TABLE.values[FACTORIAL_TABLE_SIZE - 1];
+	for (unsigned i = FACTORIAL_TABLE_SIZE; i <= n; ++i) {
+		result = result * BigUnsigned(i);
+	}
+	return result;
+}
+
 int towers(int rings, int source = -1, int spare = 0, int dest = 0) {
 	if (source < 0) {
 		source = rings;
@@ -209,6 +1684,82 @@ int towers(int rings, int source = -1, int spare = 0, int dest = 0) {
 	return count;
 }
 
+// One move of the Towers of Hanoi: disk (1 is the smallest) goes from peg from to peg to.
+struct HanoiMove {
+	int disk;
+	int from;
+	int to;
+};
+
+// The 2^rings - 1 moves that take a tower of rings disks from peg 0 to peg 2, generated lazily
+// from the binary formulation instead of a call tree: move m (1 based) moves the disk numbered by
+// the lowest set bit of m, from peg (m & (m - 1)) % 3 to peg ((m | (m - 1)) + 1) % 3. For an even
+// number of rings that lands the tower on peg 1, so pegs 1 and 2 are swapped. Each move takes O(1)
+// memory and any move can be looked up directly in O(rings).
+class HanoiMoves {
+private:
+	int rings;
+public:
+	class Iterator {
+	private:
+		const HanoiMoves* moves;
+		unsigned long long index;
+	public:
+		Iterator(const HanoiMoves* moves, unsigned long long index) : moves(moves), index(index) {}
+
+		HanoiMove operator*() const {
+			return (*moves)[index];
+		}
+
+		Iterator& operator++() {
+			index += 1;
+			return *this;
+		}
+
+		bool operator==(const Iterator& other) const {
+			return index == other.index;
+		}
+
+		bool operator!=(const Iterator& other) const {
+			return index != other.index;
+		}
+	};
+
+	explicit HanoiMoves(int rings) : rings(rings) {
+		if (rings < 1 || rings > MAX_HANOI_RINGS) {
+			throw runtime_error("Invalid input.");
+		}
+	}
+
+	unsigned long long size() const {
+		return (1ULL << rings) - 1;
+	}
+
+	// The i-th move, 0 based.
+	HanoiMove operator[](unsigned long long i) const {
+		unsigned long long m = i + 1;
+		int disk = 1;
+		for (unsigned long long bits = m; (bits & 1) == 0; bits >>= 1) {
+			disk += 1;
+		}
+		int from = (int)((m & (m - 1)) % 3);
+		int to = (int)(((m | (m - 1)) + 1) % 3);
+		if (rings % 2 == 0) {
+			from = from == 0 ? 0 : 3 - from;
+			to = to == 0 ? 0 : 3 - to;
+		}
+		return { disk, from, to };
+	}
+
+	Iterator begin() const {
+		return Iterator(this, 0);
+	}
+
+	Iterator end() const {
+		return Iterator(this, size());
+	}
+};
+
 void testFactorial() {
 	assert(factorial(1) == 1);
 	assert(factorial(4) == 24);
@@ -220,36 +1771,446 @@ void testFibonacci() {
 	assert(fibonacci(6) == 8);
 }
 
+void testFibonacciFast() {
+	// The naive recursions stay as the reference implementations.
+	for (int n = 1; n <= 30; ++n) {
+		assert(fibonacciFast(n) == (unsigned long long)fibonacci(n));
+		assert(fibonacciMod(n, 1000) == (unsigned long long)fibonacci(n) % 1000);
+		assert(fibonacciBig(n) == BigUnsigned(fibonacci(n)));
+	}
+	for (int n = 0; n < FIBONACCI_TABLE_SIZE; ++n) {
+		assert(fibonacciBig(n + 200) == fibonacciBig(n + 199) + fibonacciBig(n + 198));
+	}
+	assert(fibonacciBig(100).toString() == "354224848179261915075");
+	assert(fibonacciMod(1000, 1000000007) == 517691607);
+	assert(fibonacciMod(1000000000000000000ULL, 1) == 0);
+
+	// Moduli near 2^32, where the sum of two unreduced squares would overflow.
+	for (unsigned long long m : { 4294967291ULL, 4294967295ULL, 1ULL << 32 }) {
+		unsigned long long previous = 0;
+		unsigned long long current = 1;
+		for (unsigned long long n = 1; n <= 2000; ++n) {
+			assert(fibonacciMod(n, m) == current);
+			unsigned long long next = (previous + current) % m;
+			previous = current;
+			current = next;
+		}
+	}
+
+	bool threw = false;
+	try {
+		fibonacciFast(FIBONACCI_TABLE_SIZE);
+	}
+	catch (const overflow_error&) {
+		threw = true;
+	}
+	assert(threw);
+}
+
+void testFactorialFast() {
+	for (int n = 1; n <= 12; ++n) {
+		assert(factorialFast(n) == (unsigned long long)factorial(n));
+		assert(factorialBig(n) == BigUnsigned(factorial(n)));
+	}
+	assert(factorialFast(0) == 1);
+	assert(factorialBig(20) == BigUnsigned(factorialFast(20)));
+	assert(factorialBig(25).toString() == "15511210043330985984000000");
+	assert(factorialMod(100000, 1000000007) == 457992974);
+	assert(factorialMod(100000, 1000) == 0);
+	assert(BigUnsigned(0).toString() == "0");
+	assert(BigUnsigned(1000000000).toString() == "1000000000");
+}
+
 void testTowers() {
 	assert(towers(1) == 1);
 	assert(towers(3) == 7);
 	assert(towers(5) == 31);
 }
 
+// Recursive reference for HanoiMoves: move rings disks from source to dest.
+void recordTowerMoves(int rings, int source, int spare, int dest, vector<HanoiMove>& moves) {
+	if (rings == 0) {
+		return;
+	}
+	recordTowerMoves(rings - 1, source, dest, spare, moves);
+	moves.push_back({ rings, source, dest });
+	recordTowerMoves(rings - 1, spare, source, dest, moves);
+}
+
+void testHanoiMoves() {
+	for (int rings = 1; rings <= 12; ++rings) {
+		HanoiMoves moves(rings);
+		assert(moves.size() == (unsigned long long)towers(rings));
+
+		vector<HanoiMove> expected;
+		recordTowerMoves(rings, 0, 1, 2, expected);
+
+		// Replay the streamed moves on real pegs to check each one is legal.
+		vector<int> pegs[3];
+		for (int disk = rings; disk >= 1; --disk) {
+			pegs[0].push_back(disk);
+		}
+		unsigned long long i = 0;
+		for (HanoiMove move : moves) {
+			assert(move.disk == expected[i].disk && move.from == expected[i].from && move.to == expected[i].to);
+			assert(!pegs[move.from].empty() && pegs[move.from].back() == move.disk);
+			assert(pegs[move.to].empty() || pegs[move.to].back() > move.disk);
+			pegs[move.from].pop_back();
+			pegs[move.to].push_back(move.disk);
+			i += 1;
+		}
+		assert(i == moves.size() && pegs[2].size() == (size_t)rings);
+	}
+
+	// Random access far into a huge tower: the middle move always moves the largest disk.
+	HanoiMoves big(40);
+	HanoiMove middle = big[big.size() / 2];
+	assert(middle.disk == 40 && middle.from == 0 && middle.to == 2);
+}
+
+// Streams the moves for towers of 1 to depth rings and reports the generation rate. Only the first
+// MAX_TIMED_HANOI_MOVES moves are timed, since the larger towers have around a trillion moves.
 void towersBigO(const int depth) {
 	for (int i = 1; i <= depth; i++) {
-		cout << "towers(" << i << "): " << towers(i) << endl;
+		HanoiMoves moves(i);
+		unsigned long long timedMoves = min(moves.size(), MAX_TIMED_HANOI_MOVES);
+
+		auto begin = chrono::steady_clock::now();
+		unsigned long long checksum = 0;
+		HanoiMoves::Iterator move = moves.begin();
+		for (unsigned long long m = 0; m < timedMoves; ++m, ++move) {
+			checksum += (*move).to;
+		}
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+
+		// Keeps the compiler from skipping the generation loop.
+		volatile unsigned long long sink = checksum;
+		(void)sink;
+
+		cout << "towers(" << i << "): " << moves.size() << " moves, "
+			<< (elapsed.count() > 0 ? timedMoves / elapsed.count() : 0.0) << " moves/second" << endl;
 	}
 }
 
 void testPartition() {
 	int* testArr = new int[10] {9, 7, 5, 1, 8, 2, 4, 3, 6, 10};
 	assert(partition(2, testArr, 0, 9) == 4);
+	for (int i = 0; i < 10; ++i) {
+		assert(i < 4 ? testArr[i] <= 5 : testArr[i] >= 5);
+	}
+	delete[] testArr;
+
+	int* equalArr = new int[6] {3, 3, 3, 3, 3, 3};
+	int pivotIndex = partition(0, equalArr, 0, 5);
+	assert(pivotIndex >= 1 && pivotIndex <= 4);
+	delete[] equalArr;
+}
+
+void testPartitionThreeWay() {
+	int* testArr = new int[10] {5, 7, 5, 1, 8, 5, 4, 3, 5, 10};
+	EqualRange equal = partitionThreeWay(2, testArr, 0, 9);
+	assert(equal.lt == 3 && equal.gt == 7);
+	for (int i = 0; i < 10; ++i) {
+		assert(i < equal.lt ? testArr[i] < 5 : i < equal.gt ? testArr[i] == 5 : testArr[i] > 5);
+	}
 	delete[] testArr;
+
+	int* equalArr = new int[4] {3, 3, 3, 3};
+	equal = partitionThreeWay(1, equalArr, 0, 3);
+	assert(equal.lt == 0 && equal.gt == 4);
+	delete[] equalArr;
+}
+
+// Checks the compress partition kernels for every instruction set this CPU supports, on sizes
+// that exercise both the vector body and the scalar tail.
+void testPartitionSimd() {
+	SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512 };
+	for (SimdLevel level : levels) {
+		if (level > simdLevel()) {
+			continue;
+		}
+		for (int n : { 1, 7, 8, 15, 16, 17, 100, 1000 }) {
+			int* arr = new int[n];
+			for (int i = 0; i < n; ++i) {
+				arr[i] = rand() % 10;
+			}
+			int pivotIndex = n / 2;
+			int pivotValue = arr[pivotIndex];
+
+			int* twoWay = copyArray(arr, n);
+			int index = partitionSimd(level, pivotIndex, twoWay, 0, n - 1);
+			assert(twoWay[index] == pivotValue);
+			for (int i = 0; i < n; ++i) {
+				assert(i < index ? twoWay[i] <= pivotValue : twoWay[i] >= pivotValue);
+			}
+
+			int* threeWay = copyArray(arr, n);
+			EqualRange equal = partitionThreeWaySimd(level, pivotIndex, threeWay, 0, n - 1);
+			assert(equal.lt < equal.gt);
+			for (int i = 0; i < n; ++i) {
+				assert(i < equal.lt ? threeWay[i] < pivotValue : i < equal.gt ? threeWay[i] == pivotValue : threeWay[i] > pivotValue);
+			}
+
+			sort(arr, arr + n);
+			sort(twoWay, twoWay + n);
+			sort(threeWay, threeWay + n);
+			assert(std::equal(arr, arr + n, twoWay) && std::equal(arr, arr + n, threeWay));
+
+			delete[] threeWay;
+			delete[] twoWay;
+			delete[] arr;
+		}
+	}
+
+	// A selection large enough to grow the scratch buffer past what is retained must free it on return.
+	const int n = 4 * PARTITION_SCRATCH_RETAINED;
+	int* arr = new int[n];
+	for (int i = 0; i < n; ++i) {
+		arr[i] = rand();
+	}
+	findKthSmallestValue(n / 2, arr, 0, n - 1);
+	assert(partitionScratchBuffer.capacity() <= PARTITION_SCRATCH_RETAINED);
+	delete[] arr;
+}
+
+// Tests findKthSmallestValueParallel on arrays big enough to take the parallel path, with thread
+// counts that do and do not divide the array evenly.
+void testFindKthSmallestValueParallel() {
+	const int n = 3 * PARALLEL_SELECTION_THRESHOLD + 17;
+	int* arr = new int[n];
+	for (int pattern = 0; pattern < TEST_PATTERN_COUNT; ++pattern) {
+		fillTestPattern(pattern, arr, n);
+		int* sorted = copyArray(arr, n);
+		sort(sorted, sorted + n);
+
+		for (unsigned threads : { 1u, 2u, 3u, 4u }) {
+			for (int k : { 0, n / 3, n / 2, n - 1 }) {
+				int* copy = copyArray(arr, n);
+				assert(findKthSmallestValueParallel(k, copy, 0, n - 1, threads) == sorted[k]);
+				for (int i = 0; i < n; ++i) {
+					assert(i < k ? copy[i] <= sorted[k] : copy[i] >= sorted[k]);
+				}
+				delete[] copy;
+			}
+		}
+		delete[] sorted;
+	}
+	delete[] arr;
+}
+
+// Writes test files that fit in memory and checks findKthSmallestValueInFile against the in-memory
+// findKthSmallestValue, once with room to materialize the bucket and once without.
+void testFindKthSmallestValueInFile() {
+	const string path = "findKthSmallestValueInFile.test.bin";
+	const int n = 1000000;
+	int* arr = new int[n];
+	for (int pattern = 0; pattern < TEST_PATTERN_COUNT; ++pattern) {
+		fillTestPattern(pattern, arr, n);
+		{
+			ofstream out(path, ios::binary);
+			out.write((const char*)arr, (streamsize)n * sizeof(int));
+		}
+
+		for (int k : { 0, n / 4, n / 2, n - 1 }) {
+			int* copy = copyArray(arr, n);
+			int expectedResult = findKthSmallestValue(k, copy, 0, n - 1);
+			delete[] copy;
+
+			assert(findKthSmallestValueInFile(k, path) == expectedResult);
+			assert(findKthSmallestValueInFile(k, path, 0) == expectedResult);
+		}
+	}
+	delete[] arr;
+
+	// A truncated file, with a trailing partial value, is rejected rather than silently shortened.
+	{
+		ofstream out(path, ios::binary);
+		out.write("\1\0\0\0\2\0", 6);
+	}
+	bool threw = false;
+	try {
+		findKthSmallestValueInFile(0, path);
+	}
+	catch (const runtime_error&) {
+		threw = true;
+	}
+	assert(threw);
+	remove(path.c_str());
+}
+
+// How far value is, in ranks, from target in sorted. Zero if any copy of value sits at target.
+long long rankDistance(const int sorted[], int n, int value, long long target) {
+	long long first = lower_bound(sorted, sorted + n, value) - sorted;
+	long long last = upper_bound(sorted, sorted + n, value) - sorted - 1;
+	if (target < first) {
+		return first - target;
+	}
+	return target > last ? target - last : 0;
+}
+
+// Error-bound harness for KllSketch: the sketch's percentiles, for one sketch over the whole input
+// and for four merged per-worker sketches, must be within a few percent of rank of the exact
+// findKthSmallestValue answers.
+void testKllSketch() {
+	const int n = 1000000;
+	const double quantiles[] = { 0.0, 0.5, 0.9, 0.99, 0.999, 1.0 };
+	int* arr = new int[n];
+	long long maxError = 0;
+	for (int pattern = 0; pattern < TEST_PATTERN_COUNT; ++pattern) {
+		fillTestPattern(pattern, arr, n);
+		int* sorted = copyArray(arr, n);
+		sort(sorted, sorted + n);
+
+		KllSketch whole;
+		KllSketch workers[4] = { KllSketch(KLL_DEFAULT_K, 1), KllSketch(KLL_DEFAULT_K, 2), KllSketch(KLL_DEFAULT_K, 3), KllSketch(KLL_DEFAULT_K, 4) };
+		for (int i = 0; i < n; ++i) {
+			whole.insert(arr[i]);
+			workers[i % 4].insert(arr[i]);
+		}
+		KllSketch merged;
+		for (const KllSketch& worker : workers) {
+			merged.merge(worker);
+		}
+		assert(whole.getCount() == n && merged.getCount() == n);
+		assert(whole.getRetainedCount() < 4 * KLL_DEFAULT_K);
+
+		for (double q : quantiles) {
+			int k = (int)(q * (n - 1));
+			int* copy = copyArray(arr, n);
+			int exact = findKthSmallestValue(k, copy, 0, n - 1);
+			delete[] copy;
+
+			for (const KllSketch* sketch : { &whole, &merged }) {
+				int approximate = sketch->quantile(q);
+				long long error = approximate == exact ? 0 : rankDistance(sorted, n, approximate, k);
+				maxError = max(maxError, error);
+				assert(error <= n / 50);
+			}
+		}
+		delete[] sorted;
+	}
+	delete[] arr;
+	cout << "KLL sketch max rank error: " << (double)maxError / n * 100 << "% of " << n << " values" << endl;
+}
+
+// A struct key with a payload, to select records rather than plain numbers.
+struct TestRecord {
+	long long key;
+	int payload;
+};
+
+// Checks that [first, last) was left partitioned around kth by comp.
+template<typename RandomIt, typename Compare>
+bool isPartitionedAround(RandomIt first, RandomIt kth, RandomIt last, Compare comp) {
+	for (RandomIt i = first; i != last; ++i) {
+		if ((i < kth && comp(*kth, *i)) || (i > kth && comp(*i, *kth))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Runs selectKthSmallest on double, 64 bit, struct and std::string data from several threads at
+// once, each with its own thread-local pivot sampler, and compares against std::sort.
+void testSelectKthSmallest() {
+	auto work = [](unsigned t) {
+		FastRandom dataRandom(t + 1);
+		for (int n : { 1, 2, 17, 1000, 100000 }) {
+			vector<double> doubles(n);
+			vector<unsigned long long> wide(n);
+			vector<TestRecord> records(n);
+			vector<string> strings(min(n, 1000));
+			for (int i = 0; i < n; ++i) {
+				doubles[i] = (double)(dataRandom.next() % 1000) / 7.0;
+				wide[i] = dataRandom.next();
+				records[i] = { (long long)(dataRandom.next() % 100) - 50, i };
+			}
+			for (string& str : strings) {
+				str = to_string(dataRandom.next() % 500);
+			}
+
+			for (size_t k : { (size_t)0, (size_t)n / 2, (size_t)n - 1 }) {
+				vector<double> sortedDoubles = doubles;
+				sort(sortedDoubles.begin(), sortedDoubles.end());
+				vector<double> d = doubles;
+				selectKthSmallest(d.begin(), d.begin() + k, d.end());
+				assert(d[k] == sortedDoubles[k] && isPartitionedAround(d.begin(), d.begin() + k, d.end(), less<>()));
+
+				vector<unsigned long long> sortedWide = wide;
+				sort(sortedWide.begin(), sortedWide.end(), greater<>());
+				vector<unsigned long long> w = wide;
+				selectKthSmallest(w.begin(), w.begin() + k, w.end(), greater<>());
+				assert(w[k] == sortedWide[k]);
+
+				auto byKey = [](const TestRecord& a, const TestRecord& b) { return a.key < b.key; };
+				vector<TestRecord> sortedRecords = records;
+				sort(sortedRecords.begin(), sortedRecords.end(), byKey);
+				vector<TestRecord> r = records;
+				FastRandom callRandom(k + 1);
+				selectKthSmallest(r.begin(), r.begin() + k, r.end(), byKey, callRandom);
+				assert(r[k].key == sortedRecords[k].key && isPartitionedAround(r.begin(), r.begin() + k, r.end(), byKey));
+
+				size_t stringK = min(k, strings.size() - 1);
+				vector<string> sortedStrings = strings;
+				sort(sortedStrings.begin(), sortedStrings.end());
+				vector<string> str = strings;
+				selectKthSmallest(str.begin(), str.begin() + stringK, str.end());
+				assert(str[stringK] == sortedStrings[stringK]);
+			}
+		}
+	};
+	runOnThreads(4, work);
 }
 
-int main() {
+void testMedianOfMedians() {
+	const int n = 1000;
+	int* arr = new int[n];
+	fillTestPattern(0, arr, n);
+	int* sorted = copyArray(arr, n);
+	sort(sorted, sorted + n);
+
+	int* generic = copyArray(arr, n);
+	int pivotValue = arr[chooseMedianOfMediansPivotIndex(arr, 0, n - 1)];
+	int rank = (int)(lower_bound(sorted, sorted + n, pivotValue) - sorted);
+	assert(rank >= 3 * n / 10 - 5 && rank <= 7 * n / 10 + 5);
+
+	less<int> comp;
+	pivotValue = *chooseMedianOfMedians(generic, generic + n, comp, threadRandom());
+	rank = (int)(lower_bound(sorted, sorted + n, pivotValue) - sorted);
+	assert(rank >= 3 * n / 10 - 5 && rank <= 7 * n / 10 + 5);
+	delete[] generic;
+
+	delete[] sorted;
+	delete[] arr;
+}
+
+int main(int argc, char* argv[]) {
+	bool large = argc > 1 && strcmp(argv[1], "--large") == 0;
+
 	testFactorial();
 	testFibonacci();
+	testFactorialFast();
+	testFibonacciFast();
 	testTowers();
+	testHanoiMoves();
 	testPartition();
+	testPartitionThreeWay();
+	testPartitionSimd();
+	testMedianOfMedians();
 
 	// Seed the random number generator
 	srand(0);
 
 	// Only need to test the first few array sizes to fully test per the minimal testing equivalence class.
 	testFindKthSmallestValue(3, 5);
+	testFindKthSmallestValueLargeArrays(large ? 100000000 : 1000000);
+	testFindKthSmallestValueParallel();
+	testFindKthSmallestValueInFile();
+	testKllSketch();
+	testSelectKthSmallest();
 
-	towersBigO(10);
+	partitionModeBigO(1000000);
+	parallelSelectionBigO(1 << 24, max(1u, thread::hardware_concurrency()));
+	towersBigO(40);
 	return 0;
 }
\ No newline at end of file
@@ -1,14 +1,57 @@
 // using c++20
 #include <iostream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <string>
+#include <string_view>
 #include <cctype>
+#include <charconv>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define HAS_SSE2 1
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
 template<typename T>
 class StackADT {
 public:
+    using value_type = T;
+
+    virtual ~StackADT() = default;
+
     virtual bool isEmpty() const = 0;
 
     virtual void push(const T& value) = 0;
@@ -16,46 +59,260 @@ public:
     virtual bool pop() = 0;
 };
 
+// Compile-time counterpart of StackADT: algorithms templated on a StackLike type call
+// its members directly, so they can be inlined instead of going through the vtable.
+template<typename S>
+concept StackLike = requires(S stack, const S constStack, const typename S::value_type& value) {
+    { constStack.isEmpty() } -> convertible_to<bool>;
+    stack.push(value);
+    { constStack.peek() } -> convertible_to<typename S::value_type>;
+    { stack.pop() } -> convertible_to<bool>;
+};
+
+// StackLike wrapper that owns an Impl but reaches it only through StackADT, giving the
+// templated algorithms runtime polymorphism (and a way to measure what it costs).
+template<typename Impl>
+class VirtualStack {
+public:
+    using value_type = typename Impl::value_type;
+
+private:
+    unique_ptr<StackADT<value_type>> impl;
+
+public:
+    VirtualStack() : impl(make_unique<Impl>()) {}
+    explicit VirtualStack(unique_ptr<StackADT<value_type>> impl) : impl(std::move(impl)) {}
+
+    bool isEmpty() const {
+        return impl->isEmpty();
+    }
+
+    void push(const value_type& value) {
+        impl->push(value);
+    }
+
+    value_type peek() const {
+        return impl->peek();
+    }
+
+    bool pop() {
+        return impl->pop();
+    }
+};
+
 constexpr int MIN_ARRAY_SIZE = 64;
 
-template<typename T, int N>
-class ArrayStack final : StackADT<T> {
+// Fixed-capacity stack over uninitialized, suitably aligned storage: elements are
+// constructed in place on push and destroyed on pop, so T needs no default constructor.
+// With Growable set the capacity doubles on overflow instead of throwing.
+template<typename T, int N, bool Growable = false>
+class ArrayStack final : public StackADT<T> {
 private:
     int topIndex;
-    int array[N]{};
+    int capacity;
+    T* items; // points at inlineStorage until the stack first grows
+    alignas(T) unsigned char inlineStorage[N * sizeof(T)];
+
+    T* inlineItems() {
+        return reinterpret_cast<T*>(inlineStorage);
+    }
+
+    bool isOnHeap() const {
+        return items != reinterpret_cast<const T*>(inlineStorage);
+    }
+
+    static T* allocate(int count) {
+        return static_cast<T*>(::operator new(sizeof(T) * count, std::align_val_t(alignof(T))));
+    }
+
+    void releaseStorage() {
+        if (isOnHeap()) {
+            ::operator delete(items, std::align_val_t(alignof(T)));
+        }
+        items = inlineItems();
+        capacity = N;
+    }
+
+    // Moves the elements into a block twice the size; copies only if T's move can throw.
+    void grow() {
+        int newCapacity = capacity * 2;
+        T* newItems = allocate(newCapacity);
+        try {
+            if constexpr (is_nothrow_move_constructible_v<T> || !is_copy_constructible_v<T>) {
+                uninitialized_move(items, items + topIndex + 1, newItems);
+            }
+            else {
+                uninitialized_copy(items, items + topIndex + 1, newItems);
+            }
+        }
+        catch (...) {
+            ::operator delete(newItems, std::align_val_t(alignof(T)));
+            throw;
+        }
+        destroy(items, items + topIndex + 1);
+        releaseStorage();
+        items = newItems;
+        capacity = newCapacity;
+    }
+
+    void makeRoom() {
+        if constexpr (Growable) {
+            if (topIndex + 1 == capacity) {
+                grow();
+            }
+        }
+        else if (topIndex + 1 >= N) {
+            throw std::length_error("Max array exceeded.");
+        }
+    }
+
+    void copyFrom(const ArrayStack& other) {
+        if (other.topIndex + 1 > capacity) {
+            releaseStorage();
+            items = allocate(other.capacity);
+            capacity = other.capacity;
+        }
+        uninitialized_copy(other.items, other.items + other.topIndex + 1, items);
+        topIndex = other.topIndex;
+    }
+
+    // Steals a heap block outright; inline elements are moved one at a time.
+    void moveFrom(ArrayStack&& other) noexcept(is_nothrow_move_constructible_v<T>) {
+        if (other.isOnHeap()) {
+            items = other.items;
+            capacity = other.capacity;
+            other.items = other.inlineItems();
+            other.capacity = N;
+        }
+        else {
+            uninitialized_move(other.items, other.items + other.topIndex + 1, items);
+            destroy(other.items, other.items + other.topIndex + 1);
+        }
+        topIndex = other.topIndex;
+        other.topIndex = -1;
+    }
+
 public:
-    ArrayStack() : topIndex(-1) {
+    using value_type = T;
+
+    ArrayStack() : topIndex(-1), capacity(N), items(inlineItems()) {
         static_assert(N >= MIN_ARRAY_SIZE);
     }
 
+    ~ArrayStack() {
+        clear();
+        releaseStorage();
+    }
+
+    ArrayStack(const ArrayStack& other) : ArrayStack() {
+        copyFrom(other);
+    }
+
+    ArrayStack(ArrayStack&& other) noexcept(is_nothrow_move_constructible_v<T>) : ArrayStack() {
+        moveFrom(std::move(other));
+    }
+
+    ArrayStack& operator=(const ArrayStack& other) {
+        if (this != &other) {
+            clear();
+            copyFrom(other);
+        }
+        return *this;
+    }
+
+    ArrayStack& operator=(ArrayStack&& other) noexcept(is_nothrow_move_constructible_v<T>) {
+        if (this != &other) {
+            clear();
+            releaseStorage();
+            moveFrom(std::move(other));
+        }
+        return *this;
+    }
+
     bool isEmpty() const override {
         return topIndex < 0;
     }
 
+    int size() const {
+        return topIndex + 1;
+    }
+
+    int getCapacity() const {
+        return capacity;
+    }
+
     void push(const T& value) override {
-        if (topIndex == N) {
-            throw std::length_error("Max array exceeded.");
-        }
-        // TODO move semantics
+        emplace(value);
+    }
+
+    void push(T&& value) {
+        emplace(std::move(value));
+    }
+
+    // Constructs the new top element in place from args and returns it.
+    template<typename... Args>
+    T& emplace(Args&&... args) {
+        makeRoom();
+        T* slot = new (items + topIndex + 1) T(std::forward<Args>(args)...);
         topIndex += 1;
-        array[topIndex] = value;
+        return *slot;
     }
 
     T peek() const override {
+        return top();
+    }
+
+    T& top() {
         if (isEmpty()) {
             throw std::logic_error("Peek on empty ArrayStack.");
         }
+        return items[topIndex];
+    }
 
-        return array[topIndex];
+    const T& top() const {
+        if (isEmpty()) {
+            throw std::logic_error("Peek on empty ArrayStack.");
+        }
+        return items[topIndex];
     }
 
     bool pop() override {
         if (isEmpty()) {
             return false;
         }
+        items[topIndex].~T();
         topIndex -= 1;
         return true;
     }
+
+    // Removes the top element and returns it by move.
+    T popValue() {
+        if (isEmpty()) {
+            throw std::logic_error("Pop on empty ArrayStack.");
+        }
+        T value(std::move(items[topIndex]));
+        pop();
+        return value;
+    }
+
+    void clear() {
+        destroy(items, items + topIndex + 1);
+        topIndex = -1;
+    }
+};
+
+// Counts constructions so tests can check that nothing is default-constructed or copied.
+struct LifetimeCounter {
+    static inline int defaults = 0;
+    static inline int copies = 0;
+    static inline int live = 0;
+    int value;
+
+    LifetimeCounter() : value(0) { defaults++; live++; }
+    explicit LifetimeCounter(int value) : value(value) { live++; }
+    LifetimeCounter(const LifetimeCounter& other) : value(other.value) { copies++; live++; }
+    LifetimeCounter(LifetimeCounter&& other) noexcept : value(other.value) { live++; }
+    ~LifetimeCounter() { live--; }
 };
 
 void testArrayStack() {
@@ -69,6 +326,74 @@ void testArrayStack() {
     assert(stack0.peek() == 10);
     assert(stack0.pop());
     assert(stack0.isEmpty());
+    assert(!stack0.pop());
+
+    // Exactly N pushes fit; the next one throws.
+    for (int i = 0; i < MIN_ARRAY_SIZE; i++) {
+        stack0.push(i);
+    }
+    assert(stack0.size() == MIN_ARRAY_SIZE);
+    bool threw = false;
+    try {
+        stack0.push(MIN_ARRAY_SIZE);
+    }
+    catch (const length_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(stack0.peek() == MIN_ARRAY_SIZE - 1);
+
+    // Non-trivial values are stored whole, not truncated.
+    ArrayStack<string, MIN_ARRAY_SIZE> strings;
+    string longWord(100, 'x');
+    strings.push(longWord);
+    strings.push(string("moved"));
+    strings.emplace(3, 'z');
+    assert(strings.peek() == "zzz");
+    assert(strings.popValue() == "zzz");
+    assert(strings.popValue() == "moved");
+    assert(strings.popValue() == longWord);
+    assert(strings.isEmpty());
+
+    // Growth keeps order and never default-constructs or copies.
+    LifetimeCounter::defaults = LifetimeCounter::copies = LifetimeCounter::live = 0;
+    {
+        ArrayStack<LifetimeCounter, MIN_ARRAY_SIZE, true> growable;
+        for (int i = 0; i < 1000; i++) {
+            if (i % 2 == 0) growable.emplace(i);
+            else growable.push(LifetimeCounter(i));
+        }
+        assert(growable.size() == 1000 && growable.getCapacity() >= 1000);
+        assert(LifetimeCounter::defaults == 0 && LifetimeCounter::copies == 0);
+        assert(LifetimeCounter::live == 1000);
+
+        ArrayStack<LifetimeCounter, MIN_ARRAY_SIZE, true> moved(std::move(growable));
+        assert(growable.isEmpty() && moved.size() == 1000);
+        for (int i = 999; i >= 500; i--) {
+            assert(moved.popValue().value == i);
+        }
+        assert(LifetimeCounter::copies == 0);
+
+        ArrayStack<LifetimeCounter, MIN_ARRAY_SIZE, true> copied(moved);
+        assert(copied.size() == 500 && LifetimeCounter::copies == 500);
+        copied = std::move(growable);
+        assert(copied.isEmpty());
+        growable = moved;
+        assert(growable.size() == 500 && growable.top().value == 499);
+
+        // Assigning a larger grown stack into a smaller grown one replaces its heap block.
+        ArrayStack<LifetimeCounter, MIN_ARRAY_SIZE, true> smaller;
+        for (int i = 0; i < 100; i++) {
+            smaller.emplace(i);
+        }
+        ArrayStack<LifetimeCounter, MIN_ARRAY_SIZE, true> larger;
+        for (int i = 0; i < 200; i++) {
+            larger.emplace(i);
+        }
+        smaller = larger;
+        assert(smaller.size() == 200 && smaller.top().value == 199 && smaller.getCapacity() >= 200);
+    }
+    assert(LifetimeCounter::live == 0);
 }
 
 template<typename T>
@@ -193,154 +518,2494 @@ void testListStack() {
     assert(stack2.peek() == 3);
 }
 
-bool areCurleyBracesMatched(const string& inputString) {
-    ArrayStack<char, MIN_ARRAY_SIZE> stack;
-    for (int i = 0; i < inputString.length(); i++) {
-        char thisChar = inputString[i];
-        if (thisChar == '{') {
-            stack.push(thisChar);
-        }
-        else if (thisChar == '}') {
-            if (stack.isEmpty()) return false;
-            else stack.pop();
+// Unrolled stack: elements live in page-sized blocks linked top to bottom, so a push or
+// pop only touches the allocator once per block. The most recently emptied block is kept
+// as a spare, which stops a stack hovering at a block boundary from allocating on every push.
+template<typename T>
+class ChunkedStack : public StackADT<T> {
+private:
+    static constexpr int BLOCK_BYTES = 4096;
+    static constexpr int BLOCK_CAPACITY = (BLOCK_BYTES - (int)sizeof(void*)) / (int)sizeof(T) > 0
+        ? (BLOCK_BYTES - (int)sizeof(void*)) / (int)sizeof(T) : 1;
+
+    struct Block {
+        Block* previous;
+        alignas(T) unsigned char storage[BLOCK_CAPACITY * sizeof(T)];
+
+        T* items() {
+            return reinterpret_cast<T*>(storage);
         }
+    };
+
+    Block* topBlock; // block holding the top element, nullptr when empty
+    int topCount;    // elements used in topBlock
+    int count;
+    Block* spare;
+
+    void swap(ChunkedStack& other) noexcept {
+        std::swap(topBlock, other.topBlock);
+        std::swap(topCount, other.topCount);
+        std::swap(count, other.count);
+        std::swap(spare, other.spare);
     }
 
-    if (not stack.isEmpty()) return false;
-    return true;
-}
+public:
+    using value_type = T;
 
-void testAreCurleyBracesMatched() {
-    assert(areCurleyBracesMatched(""));
-    assert(areCurleyBracesMatched("{}"));
-    assert(areCurleyBracesMatched("a{bc}d"));
-    assert(!areCurleyBracesMatched("{"));
-    assert(!areCurleyBracesMatched("}"));
-    assert(!areCurleyBracesMatched("a{b{c}"));
-};
+    ChunkedStack() : topBlock(nullptr), topCount(0), count(0), spare(nullptr) {}
 
-bool isPalindrome(const string& inputString) {
-    int i = 0;
-    int l = inputString.length();
-    ArrayStack<char, MIN_ARRAY_SIZE> stack;
-    while (i < l / 2) {
-        stack.push(inputString[i]);
-        i++;
-    }
-    if (l % 2 == 1) i++;
-    while (i < l) {
-        if (stack.peek() != inputString[i]) return false;
-        stack.pop();
-        i++;
+    ~ChunkedStack() {
+        clear();
+        delete spare;
     }
-    return true;
-}
 
-void testIsPalindrome() {
-    assert(isPalindrome(""));
-    assert(isPalindrome("a"));
-    assert(isPalindrome("aa"));
-    assert(isPalindrome("aba"));
-    assert(isPalindrome("abba"));
-    assert(!isPalindrome("ab"));
-    assert(!isPalindrome("abaa"));
-}
+    ChunkedStack(const ChunkedStack& other) : ChunkedStack() {
+        vector<Block*> blocks;
+        for (Block* block = other.topBlock; block != nullptr; block = block->previous) {
+            blocks.push_back(block);
+        }
+        for (int b = (int)blocks.size() - 1; b >= 0; b--) {
+            int used = b == 0 ? other.topCount : BLOCK_CAPACITY;
+            for (int i = 0; i < used; i++) {
+                emplace(blocks[b]->items()[i]);
+            }
+        }
+    }
 
-string reversedString(const string& inputString) {
-    ListStack<char> wordStack;
-    for (int i = 0; i < inputString.length(); i++) {
-        wordStack.push(inputString[i]);
+    ChunkedStack(ChunkedStack&& other) noexcept : ChunkedStack() {
+        swap(other);
     }
-    string outputString;
-    while (not wordStack.isEmpty()) {
-        outputString += wordStack.peek();
-        wordStack.pop();
+
+    ChunkedStack& operator=(const ChunkedStack& other) {
+        if (this != &other) {
+            ChunkedStack copy(other);
+            swap(copy);
+        }
+        return *this;
     }
-    return outputString;
-}
 
-void testReversedString() {
-    assert(reversedString("").empty());
-    assert(reversedString("a") == "a");
-    assert(reversedString("ab") == "ba");
-    assert(reversedString("abc") == "cba");
-}
+    ChunkedStack& operator=(ChunkedStack&& other) noexcept {
+        if (this != &other) {
+            ChunkedStack hollow(std::move(other));
+            swap(hollow);
+        }
+        return *this;
+    }
 
-// Helper for infixToPostFix.
-int precedence(char op) {
-    if (op == '*' || op == '/') {
-        return 2;
+    bool isEmpty() const override {
+        return count == 0;
     }
-    else {
-        assert(op == '+' || op == '-');
-        return 1;
+
+    int size() const {
+        return count;
     }
-}
 
-// Helper for infixToPostFix.
-bool isOperator(char ch) {
-    return ch == '+' || ch == '-' || ch == '*' || ch == '/';
-}
+    void push(const T& value) override {
+        emplace(value);
+    }
 
-// Helper for infixToPostFix.
-bool isOperand(char ch) {
-    return isalpha(ch);
-}
+    void push(T&& value) {
+        emplace(std::move(value));
+    }
 
-string infixToPostFix(const string& infix) {
-    ArrayStack<char, MIN_ARRAY_SIZE> opStack;
-    string postfix;
-    for (int i = 0; i < infix.length(); i++) {
-        char thisChar = infix[i];
-        if (isOperand(thisChar)) {
-            postfix += thisChar;
-        }
-        else if (thisChar == '(') {
-            opStack.push(thisChar);
+    template<typename... Args>
+    T& emplace(Args&&... args) {
+        if (topBlock != nullptr && topCount < BLOCK_CAPACITY) {
+            T* slot = new (topBlock->items() + topCount) T(std::forward<Args>(args)...);
+            topCount += 1;
+            count += 1;
+            return *slot;
         }
-        else if (isOperator(thisChar)) {
-            while (not opStack.isEmpty() and opStack.peek() != '(' and precedence(thisChar) <= precedence(opStack.peek())) {
-                postfix += opStack.peek();
-                opStack.pop();
-            }
-            opStack.push(thisChar);
+
+        Block* block = spare != nullptr ? spare : new Block;
+        spare = nullptr;
+        T* slot;
+        try {
+            slot = new (block->items()) T(std::forward<Args>(args)...);
         }
-        else if (thisChar == ')') {
-            while (opStack.peek() != '(') {
-                postfix += opStack.peek();
-                opStack.pop();
-            }
-            opStack.pop();
+        catch (...) {
+            spare = block;
+            throw;
         }
+        block->previous = topBlock;
+        topBlock = block;
+        topCount = 1;
+        count += 1;
+        return *slot;
     }
 
-    while (not opStack.isEmpty()) {
-        postfix += opStack.peek();
-        opStack.pop();
+    T peek() const override {
+        return top();
     }
-    return postfix;
-}
 
-void testInfixToPostFix() {
-    assert(infixToPostFix("").empty());
+    T& top() {
+        if (isEmpty()) {
+            throw std::logic_error("Peek on empty ChunkedStack.");
+        }
+        return topBlock->items()[topCount - 1];
+    }
 
-    assert(infixToPostFix("a") == "a");
-    assert(infixToPostFix("a+b") == "ab+");
-    assert(infixToPostFix("a*b") == "ab*");
+    const T& top() const {
+        if (isEmpty()) {
+            throw std::logic_error("Peek on empty ChunkedStack.");
+        }
+        return topBlock->items()[topCount - 1];
+    }
 
-    assert(infixToPostFix("a+b*c") == "abc*+");
-    assert(infixToPostFix("a+(b*c)") == "abc*+");
-    assert(infixToPostFix("(a+(b*c))") == "abc*+");
+    bool pop() override {
+        if (isEmpty()) {
+            return false;
+        }
+        topCount -= 1;
+        count -= 1;
+        topBlock->items()[topCount].~T();
+        if (topCount == 0) {
+            Block* emptied = topBlock;
+            topBlock = emptied->previous;
+            topCount = topBlock != nullptr ? BLOCK_CAPACITY : 0;
+            delete spare;
+            spare = emptied;
+        }
+        return true;
+    }
 
-    assert(infixToPostFix("(a+b)*c") == "ab+c*");
-    assert(infixToPostFix("((a+b)*c)") == "ab+c*");
+    // Removes the top element and returns it by move.
+    T popValue() {
+        if (isEmpty()) {
+            throw std::logic_error("Pop on empty ChunkedStack.");
+        }
+        T value(std::move(top()));
+        pop();
+        return value;
+    }
 
-    assert(infixToPostFix("a*b+c") == "ab*c+");
-    assert(infixToPostFix("(a*b)+c") == "ab*c+");
-    assert(infixToPostFix("((a*b)+c)") == "ab*c+");
-}
+    void clear() {
+        while (pop()) {}
+    }
+};
 
-class QueensBoard {
+void testChunkedStack() {
+    ChunkedStack<int> stack0;
+    assert(stack0.isEmpty());
+    assert(!stack0.pop());
+    stack0.push(10);
+    assert(stack0.peek() == 10);
+    stack0.push(20);
+    assert(stack0.peek() == 20);
+    assert(stack0.pop());
+    assert(stack0.peek() == 10);
+    assert(stack0.pop());
+    assert(stack0.isEmpty());
+
+    // Enough elements to span several blocks, then bounce across a block boundary.
+    const int n = 5000;
+    for (int i = 0; i < n; i++) {
+        stack0.push(i);
+    }
+    assert(stack0.size() == n);
+    for (int round = 0; round < 10; round++) {
+        stack0.push(-1);
+        assert(stack0.popValue() == -1);
+    }
+
+    ChunkedStack<int> stack1(stack0);
+    assert(stack1.size() == n && stack1.peek() == n - 1);
+    ChunkedStack<int> stack2(std::move(stack0));
+    assert(stack0.isEmpty() && stack2.size() == n);
+    for (int i = n - 1; i >= 0; i--) {
+        assert(stack1.popValue() == i);
+    }
+    assert(stack1.isEmpty());
+
+    stack1 = stack2;
+    assert(stack1.size() == n && stack1.peek() == n - 1);
+    stack0 = std::move(stack2);
+    assert(stack2.isEmpty() && stack0.size() == n);
+
+    // Non-trivial values, used through the interface.
+    ChunkedStack<string> strings;
+    StackADT<string>& adt = strings;
+    adt.push(string(50, 'a'));
+    strings.emplace("b");
+    assert(adt.peek() == "b");
+    assert(adt.pop());
+    assert(strings.popValue() == string(50, 'a'));
+    assert(adt.isEmpty());
+}
+
+constexpr int MAX_HAZARD_THREADS = 128;
+constexpr int RETIRE_SCAN_THRESHOLD = 2 * MAX_HAZARD_THREADS;
+
+struct alignas(64) HazardSlot {
+    atomic<const void*> pointer{nullptr};
+    atomic<bool> inUse{false};
+};
+
+// Hazard pointers shared by every ConcurrentStack. Each thread owns one slot, publishes
+// the node it is about to dereference there, and only frees a retired node once no slot
+// holds it. A freed node can't be reused while someone still compares against it, which
+// also rules out ABA on the pop CAS.
+class HazardPointers {
+private:
+    struct Retired {
+        void* pointer;
+        void (*destroy)(void*);
+    };
+
+    // Per-thread slot and retire list; leftovers are handed to the orphan list at thread exit.
+    struct ThreadRecord {
+        HazardSlot* slot;
+        vector<Retired> retired;
+
+        ThreadRecord() : slot(nullptr) {
+            for (HazardSlot& candidate : slots) {
+                bool expected = false;
+                if (!candidate.inUse.load() && candidate.inUse.compare_exchange_strong(expected, true)) {
+                    slot = &candidate;
+                    return;
+                }
+            }
+            throw std::runtime_error("Too many threads for hazard pointers.");
+        }
+
+        ~ThreadRecord() {
+            scan(retired);
+            if (!retired.empty()) {
+                lock_guard<mutex> lock(orphanMutex);
+                orphans.insert(orphans.end(), retired.begin(), retired.end());
+            }
+            slot->pointer.store(nullptr);
+            slot->inUse.store(false);
+        }
+    };
+
+    static inline HazardSlot slots[MAX_HAZARD_THREADS];
+    static inline mutex orphanMutex;
+    static inline vector<Retired> orphans;
+
+    static ThreadRecord& record() {
+        thread_local ThreadRecord threadRecord;
+        return threadRecord;
+    }
+
+    // Frees every retired pointer that no thread currently protects.
+    static void scan(vector<Retired>& retired) {
+        {
+            lock_guard<mutex> lock(orphanMutex);
+            retired.insert(retired.end(), orphans.begin(), orphans.end());
+            orphans.clear();
+        }
+        vector<const void*> protectedPointers;
+        for (HazardSlot& slot : slots) {
+            const void* pointer = slot.pointer.load();
+            if (pointer != nullptr) {
+                protectedPointers.push_back(pointer);
+            }
+        }
+        sort(protectedPointers.begin(), protectedPointers.end());
+
+        size_t kept = 0;
+        for (Retired& entry : retired) {
+            if (binary_search(protectedPointers.begin(), protectedPointers.end(), entry.pointer)) {
+                retired[kept++] = entry;
+            }
+            else {
+                entry.destroy(entry.pointer);
+            }
+        }
+        retired.resize(kept);
+    }
+
+public:
+    // Loads source into this thread's hazard slot, retrying until the published value is
+    // still current, so the result stays valid until clear().
+    template<typename P>
+    static P* protect(const atomic<P*>& source) {
+        HazardSlot& slot = *record().slot;
+        P* pointer = source.load();
+        while (true) {
+            slot.pointer.store(pointer);
+            P* current = source.load();
+            if (current == pointer) {
+                return pointer;
+            }
+            pointer = current;
+        }
+    }
+
+    static void clear() {
+        record().slot->pointer.store(nullptr);
+    }
+
+    template<typename P>
+    static void retire(P* pointer) {
+        ThreadRecord& self = record();
+        self.retired.push_back({pointer, [](void* p) { delete static_cast<P*>(p); }});
+        if ((int)self.retired.size() >= RETIRE_SCAN_THRESHOLD) {
+            scan(self.retired);
+        }
+    }
+};
+
+// Treiber stack: push and pop CAS the head pointer, and popped nodes are reclaimed through
+// HazardPointers. Nodes are never modified once published, so a peek racing with a pop
+// still reads a whole value; pop therefore copies the value out rather than moving it.
+template<typename T>
+class ConcurrentStack : public StackADT<T> {
+private:
+    struct Node {
+        T value;
+        Node* next;
+
+        template<typename... Args>
+        Node(Node* next, Args&&... args) : value(std::forward<Args>(args)...), next(next) {}
+    };
+
+    atomic<Node*> head;
+
+    void link(Node* node) {
+        node->next = head.load(memory_order_relaxed);
+        while (!head.compare_exchange_weak(node->next, node, memory_order_release, memory_order_relaxed)) {}
+    }
+
+public:
+    using value_type = T;
+
+    ConcurrentStack() : head(nullptr) {}
+
+    ConcurrentStack(const ConcurrentStack&) = delete;
+    ConcurrentStack& operator=(const ConcurrentStack&) = delete;
+
+    // Not safe to run while other threads still use the stack.
+    ~ConcurrentStack() {
+        Node* node = head.load();
+        while (node != nullptr) {
+            Node* next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    bool isEmpty() const override {
+        return head.load() == nullptr;
+    }
+
+    void push(const T& value) override {
+        link(new Node(nullptr, value));
+    }
+
+    void push(T&& value) {
+        link(new Node(nullptr, std::move(value)));
+    }
+
+    // Returns a copy of whatever is on top at the moment of the call.
+    T peek() const override {
+        Node* top = HazardPointers::protect(head);
+        if (top == nullptr) {
+            HazardPointers::clear();
+            throw std::logic_error("Peek on empty ConcurrentStack.");
+        }
+        T value(top->value);
+        HazardPointers::clear();
+        return value;
+    }
+
+    bool pop() override {
+        Node* top = unlink();
+        if (top == nullptr) {
+            return false;
+        }
+        HazardPointers::retire(top);
+        return true;
+    }
+
+    // Pops into out, or returns false if the stack was empty. Unlike peek() followed by
+    // pop(), this can't lose the value to another thread in between.
+    bool tryPop(T& out) {
+        Node* top = unlink();
+        if (top == nullptr) {
+            return false;
+        }
+        out = top->value;
+        HazardPointers::retire(top);
+        return true;
+    }
+
+private:
+    // Detaches the top node, which stays readable until it is retired.
+    Node* unlink() {
+        while (true) {
+            Node* top = HazardPointers::protect(head);
+            if (top == nullptr) {
+                HazardPointers::clear();
+                return nullptr;
+            }
+            if (head.compare_exchange_weak(top, top->next)) {
+                HazardPointers::clear();
+                return top;
+            }
+        }
+    }
+};
+
+void testConcurrentStack() {
+    ConcurrentStack<int> stack0;
+    assert(stack0.isEmpty());
+    assert(!stack0.pop());
+    stack0.push(10);
+    assert(stack0.peek() == 10);
+    stack0.push(20);
+    assert(stack0.peek() == 20);
+    assert(stack0.pop());
+    int value = 0;
+    assert(stack0.tryPop(value) && value == 10);
+    assert(!stack0.tryPop(value));
+
+    ConcurrentStack<string> strings;
+    strings.push(string(40, 's'));
+    strings.push("top");
+    assert(strings.peek() == "top");
+    string word;
+    assert(strings.tryPop(word) && word == "top");
+
+    // Producers and consumers race; every pushed value must come out exactly once.
+    const int producers = 4;
+    const int consumers = 4;
+    const int perProducer = 20000;
+    const int total = producers * perProducer;
+    vector<atomic<int>> seen(total);
+    atomic<int> popped{0};
+    vector<thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&stack0, p]() {
+            for (int i = 0; i < perProducer; i++) {
+                stack0.push(p * perProducer + i);
+            }
+        });
+    }
+    for (int c = 0; c < consumers; c++) {
+        threads.emplace_back([&]() {
+            int item;
+            while (popped.load() < total) {
+                if (stack0.tryPop(item)) {
+                    seen[item].fetch_add(1);
+                    popped.fetch_add(1);
+                }
+                else if (!stack0.isEmpty()) {
+                    try {
+                        int top = stack0.peek();
+                        assert(top >= 0 && top < total);
+                    }
+                    catch (const logic_error&) {}
+                }
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    assert(stack0.isEmpty());
+    for (int i = 0; i < total; i++) {
+        assert(seen[i].load() == 1);
+    }
+}
+
+// Mutex-wrapped ListStack, the baseline the concurrent stack replaces.
+template<typename T>
+class LockedListStack {
+private:
+    mutex lock;
+    ListStack<T> stack;
+public:
+    void push(const T& value) {
+        lock_guard<mutex> guard(lock);
+        stack.push(value);
+    }
+
+    bool tryPop(T& out) {
+        lock_guard<mutex> guard(lock);
+        if (stack.isEmpty()) {
+            return false;
+        }
+        out = stack.peek();
+        stack.pop();
+        return true;
+    }
+};
+
+// Each thread alternates push and tryPop; returns millions of operations per second.
+template<typename Stack>
+double stackThroughput(Stack& stack, int threadCount, int operationsPerThread) {
+    atomic<long long> checksum{0};
+    vector<thread> threads;
+    auto begin = chrono::steady_clock::now();
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&stack, &checksum, operationsPerThread]() {
+            long long local = 0;
+            int value;
+            for (int i = 0; i < operationsPerThread; i += 2) {
+                stack.push(i);
+                if (stack.tryPop(value)) {
+                    local += value;
+                }
+            }
+            checksum.fetch_add(local);
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - begin;
+
+    // Keeps the compiler from skipping the stack work.
+    volatile long long sink = checksum.load();
+    (void)sink;
+    return (double)threadCount * operationsPerThread / elapsed.count();
+}
+
+void concurrentStackBigO(int maxThreads) {
+    const int operations = 1 << 21;
+    for (int threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+        int perThread = operations / threadCount;
+        LockedListStack<int> locked;
+        ConcurrentStack<int> lockFree;
+        double lockedRate = stackThroughput(locked, threadCount, perThread);
+        double lockFreeRate = stackThroughput(lockFree, threadCount, perThread);
+        cout << threadCount << " threads: mutex ListStack " << lockedRate
+            << " Mops/s, ConcurrentStack " << lockFreeRate << " Mops/s" << endl;
+    }
+}
+
+template<StackLike Stack = ArrayStack<char, MIN_ARRAY_SIZE, true>>
+bool areCurleyBracesMatched(const string& inputString) {
+    Stack stack;
+    for (int i = 0; i < inputString.length(); i++) {
+        char thisChar = inputString[i];
+        if (thisChar == '{') {
+            stack.push(thisChar);
+        }
+        else if (thisChar == '}') {
+            if (stack.isEmpty()) return false;
+            else stack.pop();
+        }
+    }
+
+    if (not stack.isEmpty()) return false;
+    return true;
+}
+
+void testAreCurleyBracesMatched() {
+    assert(areCurleyBracesMatched(""));
+    assert(areCurleyBracesMatched("{}"));
+    assert(areCurleyBracesMatched("a{bc}d"));
+    assert(!areCurleyBracesMatched("{"));
+    assert(!areCurleyBracesMatched("}"));
+    assert(!areCurleyBracesMatched("a{b{c}"));
+
+    // Any StackLike works, including StackADT behind VirtualStack.
+    static_assert(StackLike<ListStack<char>> && StackLike<ChunkedStack<char>> && StackLike<ConcurrentStack<char>>);
+    static_assert(StackLike<VirtualStack<ArrayStack<char, MIN_ARRAY_SIZE>>>);
+    static_assert(!StackLike<string>);
+    assert(areCurleyBracesMatched<ListStack<char>>("a{b{}c}"));
+    assert(!areCurleyBracesMatched<VirtualStack<ChunkedStack<char>>>("a{b{c}"));
+};
+
+// Result of checkBrackets. errorOffset is the first closer that has no matching opener,
+// or, for input that ends with brackets still open, the earliest unclosed opener.
+struct BracketCheckResult {
+    bool matched;
+    size_t errorOffset; // string::npos when matched
+};
+
+using OffsetStack = ArrayStack<size_t, MIN_ARRAY_SIZE, true>;
+
+// Helper for checkBrackets.
+inline bool isBracket(char ch) {
+    return ch == '(' || ch == ')' || ch == '[' || ch == ']' || ch == '{' || ch == '}';
+}
+
+// Helper for checkBrackets.
+inline char matchingOpener(char closer) {
+    return closer == ')' ? '(' : closer == ']' ? '[' : '{';
+}
+
+// Helper for checkBrackets: applies the bracket at data[offset], returning false on a mismatch.
+inline bool consumeBracket(const char* data, size_t offset, OffsetStack& openers) {
+    char ch = data[offset];
+    if (ch == '(' || ch == '[' || ch == '{') {
+        openers.push(offset);
+        return true;
+    }
+    if (openers.isEmpty() || data[openers.top()] != matchingOpener(ch)) {
+        return false;
+    }
+    openers.pop();
+    return true;
+}
+
+// Helper for checkBrackets: reports the earliest opener left unclosed, if any.
+inline BracketCheckResult finishBrackets(OffsetStack& openers) {
+    if (openers.isEmpty()) {
+        return {true, string::npos};
+    }
+    while (openers.size() > 1) {
+        openers.pop();
+    }
+    return {false, openers.top()};
+}
+
+BracketCheckResult checkBracketsScalar(const char* data, size_t length) {
+    OffsetStack openers;
+    for (size_t i = 0; i < length; i++) {
+        if (isBracket(data[i]) && !consumeBracket(data, i, openers)) {
+            return {false, i};
+        }
+    }
+    return finishBrackets(openers);
+}
+
+// Calls visit(offset) for each bracket in data[begin, end), in order, until visit returns
+// false. SSE2 classifies 64 bytes at a time into a bit mask, so runs of text without
+// brackets cost a few compares per block and only the brackets themselves are visited.
+//
+// Returns: The offset visit rejected, or string::npos if it accepted every bracket.
+template<typename Visit>
+size_t forEachBracket(const char* data, size_t begin, size_t end, Visit visit) {
+    size_t i = begin;
+#ifdef HAS_SSE2
+    const __m128i brackets[6] = {
+        _mm_set1_epi8('('), _mm_set1_epi8(')'), _mm_set1_epi8('['),
+        _mm_set1_epi8(']'), _mm_set1_epi8('{'), _mm_set1_epi8('}')
+    };
+    for (; i + 64 <= end; i += 64) {
+        uint64_t mask = 0;
+        for (int part = 0; part < 4; part++) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16 * part));
+            __m128i hits = _mm_cmpeq_epi8(bytes, brackets[0]);
+            for (int b = 1; b < 6; b++) {
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(bytes, brackets[b]));
+            }
+            mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(hits) << (16 * part);
+        }
+        while (mask != 0) {
+            size_t offset = i + countr_zero(mask);
+            if (!visit(offset)) {
+                return offset;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < end; i++) {
+        if (isBracket(data[i]) && !visit(i)) {
+            return i;
+        }
+    }
+    return string::npos;
+}
+
+// Validates (), [] and {} together, keeping opener offsets on a growable stack.
+BracketCheckResult checkBrackets(const char* data, size_t length) {
+    OffsetStack openers;
+    size_t mismatch = forEachBracket(data, 0, length, [&](size_t offset) {
+        return consumeBracket(data, offset, openers);
+    });
+    if (mismatch != string::npos) {
+        return {false, mismatch};
+    }
+    return finishBrackets(openers);
+}
+
+BracketCheckResult checkBrackets(const string& input) {
+    return checkBrackets(input.data(), input.length());
+}
+
+void testCheckBrackets() {
+    assert(checkBrackets("").matched);
+    assert(checkBrackets("([]{()})").matched);
+    assert(checkBrackets("int main() { return a[0]; }").matched);
+    BracketCheckResult result = checkBrackets("(]");
+    assert(!result.matched && result.errorOffset == 1);
+    result = checkBrackets("a)b");
+    assert(!result.matched && result.errorOffset == 1);
+    result = checkBrackets("x{(y)[z");
+    assert(!result.matched && result.errorOffset == 1);
+
+    // Nesting far deeper than MIN_ARRAY_SIZE.
+    const int depth = 100000;
+    string deep = string(depth, '[') + string(depth, ']');
+    assert(checkBrackets(deep).matched);
+    assert(areCurleyBracesMatched(string(depth, '{') + string(depth, '}')));
+    deep[depth + 5] = ')';
+    result = checkBrackets(deep);
+    assert(!result.matched && result.errorOffset == depth + 5);
+
+    // Long bracket-free runs with the bracket landing on every block position.
+    for (int position = 0; position < 200; position++) {
+        string text(300, 'x');
+        text[position] = '{';
+        result = checkBrackets(text);
+        assert(!result.matched && result.errorOffset == (size_t)position);
+        text[299] = '}';
+        assert(checkBrackets(text).matched == (position < 299));
+    }
+
+    // The SIMD and scalar paths agree on random bracket soup.
+    mt19937 random(20);
+    const char alphabet[] = "()[]{}ab";
+    for (int trial = 0; trial < 2000; trial++) {
+        string text(random() % 300, ' ');
+        for (char& ch : text) {
+            ch = alphabet[random() % (trial % 2 == 0 ? 8 : 6)];
+        }
+        // Half the trials use a balanced string so the matched path is covered too.
+        if (trial % 4 == 1) {
+            text.clear();
+            string closers;
+            for (int i = 0; i < 250; i++) {
+                int kind = random() % 4;
+                if (kind < 3 && closers.length() < 100) {
+                    text += "([{"[kind];
+                    closers += ")]}"[kind];
+                }
+                else if (!closers.empty()) {
+                    text += closers.back();
+                    closers.pop_back();
+                }
+            }
+            text.append(closers.rbegin(), closers.rend());
+        }
+        BracketCheckResult simd = checkBrackets(text);
+        BracketCheckResult scalar = checkBracketsScalar(text.data(), text.length());
+        assert(simd.matched == scalar.matched && simd.errorOffset == scalar.errorOffset);
+        if (trial % 4 == 1) {
+            assert(simd.matched);
+        }
+    }
+}
+
+// Builds a JSON-like payload of about n bytes with nested objects and arrays.
+string makeBracketPayload(int n) {
+    string payload = "{\"items\": [";
+    int item = 0;
+    while ((int)payload.length() < n) {
+        payload += "{\"id\": " + to_string(item++) + ", \"name\": \"item description text\", \"tags\": [\"a\", \"b\"]}, ";
+    }
+    payload += "{}]}";
+    return payload;
+}
+
+void bracketBigO(int maxSize) {
+    for (int n = 1 << 10; n <= maxSize; n <<= 4) {
+        string payload = makeBracketPayload(n);
+        int repeats = (1 << 24) / n + 1;
+
+        long long checksum = 0;
+        auto begin = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            checksum += areCurleyBracesMatched(payload);
+        }
+        auto stackTime = chrono::steady_clock::now() - begin;
+
+        begin = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            checksum += checkBracketsScalar(payload.data(), payload.length()).matched;
+        }
+        auto scalarTime = chrono::steady_clock::now() - begin;
+
+        begin = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            checksum += checkBrackets(payload).matched;
+        }
+        auto simdTime = chrono::steady_clock::now() - begin;
+
+        auto megabytesPerSecond = [&](chrono::steady_clock::duration d) {
+            return (double)payload.length() * repeats / chrono::duration<double, micro>(d).count();
+        };
+        cout << "size " << payload.length() << ": areCurleyBracesMatched " << megabytesPerSecond(stackTime)
+            << " MB/s, scalar checkBrackets " << megabytesPerSecond(scalarTime)
+            << " MB/s, SIMD checkBrackets " << megabytesPerSecond(simdTime) << " MB/s" << endl;
+
+        // Keeps the compiler from skipping the validation.
+        volatile long long sink = checksum;
+        (void)sink;
+    }
+}
+
+// Read-only memory mapping of a whole file, viewed as bytes.
+class MappedFile {
+private:
+    const char* data;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+public:
+    explicit MappedFile(const string& path) : data(nullptr), length(0) {
+#ifdef _WIN32
+        mapping = nullptr;
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw runtime_error("Could not open " + path);
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            CloseHandle(file);
+            throw runtime_error("Could not stat " + path);
+        }
+        length = (size_t)fileSize.QuadPart;
+        if (length > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data = mapping ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (data == nullptr) {
+                if (mapping) {
+                    CloseHandle(mapping);
+                }
+                CloseHandle(file);
+                throw runtime_error("Could not map " + path);
+            }
+        }
+#else
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw runtime_error("Could not open " + path);
+        }
+        struct stat info;
+        if (fstat(descriptor, &info) != 0) {
+            close(descriptor);
+            throw runtime_error("Could not stat " + path);
+        }
+        length = (size_t)info.st_size;
+        if (length > 0) {
+            void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (address == MAP_FAILED) {
+                close(descriptor);
+                throw runtime_error("Could not map " + path);
+            }
+            // Each thread reads its own chunk front to back.
+            madvise(address, length, MADV_SEQUENTIAL);
+            data = (const char*)address;
+        }
+        close(descriptor);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+#else
+        if (data) {
+            munmap((void*)data, length);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* getData() const {
+        return data;
+    }
+
+    size_t getLength() const {
+        return length;
+    }
+};
+
+// Runs work(0) .. work(threadCount - 1) concurrently, the last one on the calling thread.
+template<typename Work>
+void runOnThreads(unsigned threadCount, Work work) {
+    vector<thread> threads;
+    for (unsigned t = 0; t + 1 < threadCount; t++) {
+        threads.emplace_back(work, t);
+    }
+    work(threadCount - 1);
+    for (thread& worker : threads) {
+        worker.join();
+    }
+}
+
+constexpr size_t MIN_BRACKET_CHUNK = 1 << 16;
+
+// What one chunk of input leaves for its neighbours: closers with no opener inside the
+// chunk (waiting on openers to the left), openers still open (waiting on closers to the
+// right), and the first mismatch inside the chunk. Offsets are absolute. Nothing after
+// errorOffset is recorded, since no later bracket can be the first error.
+struct BracketSummary {
+    vector<size_t> pendingCloses;
+    vector<size_t> pendingOpens;
+    size_t errorOffset = string::npos;
+};
+
+BracketSummary summarizeBrackets(const char* data, size_t begin, size_t end) {
+    BracketSummary summary;
+    summary.errorOffset = forEachBracket(data, begin, end, [&](size_t offset) {
+        char ch = data[offset];
+        if (ch == '(' || ch == '[' || ch == '{') {
+            summary.pendingOpens.push_back(offset);
+        }
+        else if (summary.pendingOpens.empty()) {
+            summary.pendingCloses.push_back(offset);
+        }
+        else if (data[summary.pendingOpens.back()] == matchingOpener(ch)) {
+            summary.pendingOpens.pop_back();
+        }
+        else {
+            return false;
+        }
+        return true;
+    });
+    return summary;
+}
+
+// Summary of left followed directly by right. The operation is associative, so chunk
+// summaries can be combined in any tree shape.
+BracketSummary combineBracketSummaries(const char* data, BracketSummary left, BracketSummary right) {
+    if (left.errorOffset != string::npos) {
+        return left;
+    }
+    for (size_t close : right.pendingCloses) {
+        if (left.pendingOpens.empty()) {
+            left.pendingCloses.push_back(close);
+        }
+        else if (data[left.pendingOpens.back()] == matchingOpener(data[close])) {
+            left.pendingOpens.pop_back();
+        }
+        else {
+            left.errorOffset = close;
+            return left;
+        }
+    }
+    if (right.errorOffset != string::npos) {
+        left.errorOffset = right.errorOffset;
+        return left;
+    }
+    left.pendingOpens.insert(left.pendingOpens.end(), right.pendingOpens.begin(), right.pendingOpens.end());
+    return left;
+}
+
+// Verdict for a summary of the whole input, with the same offsets checkBrackets reports.
+BracketCheckResult finishBracketSummary(const BracketSummary& summary) {
+    if (!summary.pendingCloses.empty()) {
+        return {false, summary.pendingCloses.front()};
+    }
+    if (summary.errorOffset != string::npos) {
+        return {false, summary.errorOffset};
+    }
+    if (!summary.pendingOpens.empty()) {
+        return {false, summary.pendingOpens.front()};
+    }
+    return {true, string::npos};
+}
+
+// checkBrackets split across threads: each thread summarizes one chunk, then neighbouring
+// summaries are combined pairwise, in parallel, until one is left.
+BracketCheckResult checkBracketsParallel(const char* data, size_t length, unsigned threadCount) {
+    size_t chunkCount = min<size_t>(max(threadCount, 1u), max<size_t>(length / MIN_BRACKET_CHUNK, 1));
+    vector<BracketSummary> summaries(chunkCount);
+    runOnThreads((unsigned)chunkCount, [&](unsigned c) {
+        summaries[c] = summarizeBrackets(data, length * c / chunkCount, length * (c + 1) / chunkCount);
+    });
+
+    while (summaries.size() > 1) {
+        size_t pairs = summaries.size() / 2;
+        vector<BracketSummary> combined(pairs + summaries.size() % 2);
+        runOnThreads((unsigned)pairs, [&](unsigned p) {
+            combined[p] = combineBracketSummaries(data, std::move(summaries[2 * p]), std::move(summaries[2 * p + 1]));
+        });
+        if (summaries.size() % 2 == 1) {
+            combined.back() = std::move(summaries.back());
+        }
+        summaries = std::move(combined);
+    }
+    return finishBracketSummary(summaries[0]);
+}
+
+BracketCheckResult checkBracketsInFile(const string& path, unsigned threadCount = thread::hardware_concurrency()) {
+    MappedFile file(path);
+    return checkBracketsParallel(file.getData(), file.getLength(), threadCount);
+}
+
+void testCheckBracketsParallel() {
+    // Every split point, and both groupings of three pieces, agree with checkBrackets.
+    const string samples[] = { "", "()", ")(", "([)]", "a{b[c]d}e", "{[()()]}(", "(()]]", "}}{{", "([{}])[" };
+    for (const string& text : samples) {
+        BracketCheckResult expected = checkBrackets(text);
+        const char* data = text.data();
+        size_t n = text.length();
+        for (size_t i = 0; i <= n; i++) {
+            BracketCheckResult split = finishBracketSummary(combineBracketSummaries(data,
+                summarizeBrackets(data, 0, i), summarizeBrackets(data, i, n)));
+            assert(split.matched == expected.matched && split.errorOffset == expected.errorOffset);
+            for (size_t j = i; j <= n; j++) {
+                BracketCheckResult leftFirst = finishBracketSummary(combineBracketSummaries(data,
+                    combineBracketSummaries(data, summarizeBrackets(data, 0, i), summarizeBrackets(data, i, j)),
+                    summarizeBrackets(data, j, n)));
+                BracketCheckResult rightFirst = finishBracketSummary(combineBracketSummaries(data,
+                    summarizeBrackets(data, 0, i),
+                    combineBracketSummaries(data, summarizeBrackets(data, i, j), summarizeBrackets(data, j, n))));
+                assert(leftFirst.matched == expected.matched && leftFirst.errorOffset == expected.errorOffset);
+                assert(rightFirst.matched == expected.matched && rightFirst.errorOffset == expected.errorOffset);
+            }
+        }
+    }
+
+    // Large balanced inputs, then the same with one bracket broken, across thread counts.
+    mt19937 random(21);
+    for (int trial = 0; trial < 12; trial++) {
+        string text;
+        string closers;
+        while (text.length() < 1000000) {
+            int kind = random() % 8;
+            if (kind < 3) {
+                text += "([{"[kind];
+                closers += ")]}"[kind];
+            }
+            else if (kind < 6 && !closers.empty()) {
+                text += closers.back();
+                closers.pop_back();
+            }
+            else {
+                text += "text";
+            }
+        }
+        text.append(closers.rbegin(), closers.rend());
+        if (trial % 3 == 1) {
+            size_t position = random() % text.length();
+            text[position] = "([{)]}"[random() % 6];
+        }
+        else if (trial % 3 == 2) {
+            text.insert(random() % text.length(), 1, "([{)]}"[random() % 6]);
+        }
+
+        BracketCheckResult expected = checkBrackets(text);
+        assert(trial % 3 == 1 || expected.matched == (trial % 3 == 0));
+        for (unsigned threads : { 1u, 2u, 3u, 7u, 16u }) {
+            BracketCheckResult result = checkBracketsParallel(text.data(), text.length(), threads);
+            assert(result.matched == expected.matched && result.errorOffset == expected.errorOffset);
+        }
+    }
+
+    const string path = "checkBracketsInFile.test.txt";
+    string payload = makeBracketPayload(1 << 20);
+    {
+        ofstream out(path, ios::binary);
+        out << payload << "]";
+    }
+    BracketCheckResult result = checkBracketsInFile(path, 4);
+    assert(!result.matched && result.errorOffset == payload.length());
+    remove(path.c_str());
+}
+
+// Thread scaling of checkBracketsInFile on a file that is already in the page cache.
+void bracketFileBigO(int size) {
+    const string path = "bracketFileBigO.txt";
+    {
+        ofstream out(path, ios::binary);
+        out << makeBracketPayload(size);
+    }
+    checkBracketsInFile(path, 1);
+
+    unsigned maxThreads = max(thread::hardware_concurrency(), 1u);
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        auto begin = chrono::steady_clock::now();
+        BracketCheckResult result = checkBracketsInFile(path, threads);
+        chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - begin;
+        cout << threads << " threads: checkBracketsInFile " << size / elapsed.count() << " MB/s"
+            << (result.matched ? "" : " (mismatch)") << endl;
+    }
+    remove(path.c_str());
+}
+
+template<StackLike Stack = ArrayStack<char, MIN_ARRAY_SIZE, true>>
+bool isPalindrome(const string& inputString) {
+    int i = 0;
+    int l = inputString.length();
+    Stack stack;
+    while (i < l / 2) {
+        stack.push(inputString[i]);
+        i++;
+    }
+    if (l % 2 == 1) i++;
+    while (i < l) {
+        if (stack.peek() != inputString[i]) return false;
+        stack.pop();
+        i++;
+    }
+    return true;
+}
+
+void testIsPalindrome() {
+    assert(isPalindrome(""));
+    assert(isPalindrome("a"));
+    assert(isPalindrome("aa"));
+    assert(isPalindrome("aba"));
+    assert(isPalindrome("abba"));
+    assert(!isPalindrome("ab"));
+    assert(!isPalindrome("abaa"));
+    assert(isPalindrome<VirtualStack<ListStack<char>>>("abcba"));
+    assert(!isPalindrome<ChunkedStack<char>>("abcab"));
+}
+
+template<StackLike Stack = ChunkedStack<char>>
+string reversedString(const string& inputString) {
+    Stack wordStack;
+    for (int i = 0; i < inputString.length(); i++) {
+        wordStack.push(inputString[i]);
+    }
+    string outputString;
+    while (not wordStack.isEmpty()) {
+        outputString += wordStack.peek();
+        wordStack.pop();
+    }
+    return outputString;
+}
+
+void testReversedString() {
+    assert(reversedString("").empty());
+    assert(reversedString("a") == "a");
+    assert(reversedString("ab") == "ba");
+    assert(reversedString("abc") == "cba");
+}
+
+#ifdef HAS_SSE2
+// Reverses the 16 bytes of v using only SSE2: swap the dwords, the words inside each
+// dword, then the bytes inside each word.
+inline __m128i reverse16(__m128i v) {
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+#endif
+
+// Reverses data[0, length) in place, swapping 16-byte blocks from both ends.
+void reverseInPlace(char* data, size_t length) {
+    size_t front = 0;
+    size_t back = length;
+#ifdef HAS_SSE2
+    while (back - front >= 32) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + front));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + back - 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + front), reverse16(tail));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + back - 16), reverse16(head));
+        front += 16;
+        back -= 16;
+    }
+#endif
+    while (back - front >= 2) {
+        swap(data[front], data[back - 1]);
+        front++;
+        back--;
+    }
+}
+
+// reversedString without a stack: fills a presized buffer from the end of the input.
+string reversedStringSimd(const string& inputString) {
+    size_t n = inputString.length();
+    string outputString(n, '\0');
+    const char* in = inputString.data();
+    char* out = outputString.data();
+    size_t i = 0;
+#ifdef HAS_SSE2
+    for (; i + 16 <= n; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + n - i - 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), reverse16(block));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = in[n - 1 - i];
+    }
+    return outputString;
+}
+
+// isPalindrome without a stack: compares each front block with the mirrored back block.
+bool isPalindromeSimd(const string& inputString) {
+    const char* data = inputString.data();
+    size_t front = 0;
+    size_t back = inputString.length();
+#ifdef HAS_SSE2
+    while (back - front >= 32) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + front));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + back - 16));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(head, reverse16(tail))) != 0xFFFF) {
+            return false;
+        }
+        front += 16;
+        back -= 16;
+    }
+#endif
+    while (back - front >= 2) {
+        if (data[front] != data[back - 1]) {
+            return false;
+        }
+        front++;
+        back--;
+    }
+    return true;
+}
+
+// Helper for the UTF-8 kernels: true for the 10xxxxxx bytes that continue a code point.
+inline bool isContinuationByte(char ch) {
+    return ((unsigned char)ch & 0xC0) == 0x80;
+}
+
+// Helper for the UTF-8 kernels: true if the 16 bytes at data are all ASCII.
+inline bool isAsciiBlock(const char* data) {
+#ifdef HAS_SSE2
+    return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data))) == 0;
+#else
+    for (int i = 0; i < 16; i++) {
+        if ((unsigned char)data[i] >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+// Reverses the code points of UTF-8 text in place. The bytes are reversed wholesale, then
+// each multi-byte sequence, which now reads continuation bytes first, is flipped back.
+// ASCII blocks are skipped 16 bytes at a time. Stray continuation bytes are kept with the
+// code point they follow, so malformed input is reordered but never loses bytes.
+void reverseUtf8InPlace(char* data, size_t length) {
+    reverseInPlace(data, length);
+    size_t i = 0;
+    while (i < length) {
+        if (i + 16 <= length && isAsciiBlock(data + i)) {
+            i += 16;
+            continue;
+        }
+        if (!isContinuationByte(data[i])) {
+            i++;
+            continue;
+        }
+        size_t end = i;
+        while (end < length && isContinuationByte(data[end])) {
+            end++;
+        }
+        // data[end] is the lead byte of this sequence, unless the input ended mid-sequence.
+        size_t last = end < length ? end : end - 1;
+        reverseInPlace(data + i, last - i + 1);
+        i = last + 1;
+    }
+}
+
+string reversedUtf8String(const string& inputString) {
+    string outputString = inputString;
+    reverseUtf8InPlace(outputString.data(), outputString.length());
+    return outputString;
+}
+
+// isPalindrome over code points rather than bytes. Pairs of ASCII blocks are compared
+// with the byte kernel; anything else steps one code point in from each end.
+bool isPalindromeUtf8(const string& inputString) {
+    const char* data = inputString.data();
+    size_t front = 0;
+    size_t back = inputString.length();
+    while (front < back) {
+#ifdef HAS_SSE2
+        if (back - front >= 32 && isAsciiBlock(data + front) && isAsciiBlock(data + back - 16)) {
+            __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + front));
+            __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + back - 16));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(head, reverse16(tail))) != 0xFFFF) {
+                return false;
+            }
+            front += 16;
+            back -= 16;
+            continue;
+        }
+#endif
+        size_t frontEnd = front + 1;
+        while (frontEnd < back && isContinuationByte(data[frontEnd])) {
+            frontEnd++;
+        }
+        size_t backStart = back - 1;
+        while (backStart > front && isContinuationByte(data[backStart])) {
+            backStart--;
+        }
+        if (backStart <= front) {
+            return true; // one code point left in the middle
+        }
+        size_t width = frontEnd - front;
+        if (back - backStart != width || memcmp(data + front, data + backStart, width) != 0) {
+            return false;
+        }
+        front = frontEnd;
+        back = backStart;
+    }
+    return true;
+}
+
+void testStringKernels() {
+    mt19937 random(22);
+    for (int n = 0; n < 200; n++) {
+        string text(n, ' ');
+        for (char& ch : text) {
+            ch = char('a' + random() % 26);
+        }
+        string expected = reversedString(text);
+        assert(reversedStringSimd(text) == expected);
+        string inPlace = text;
+        reverseInPlace(inPlace.data(), inPlace.length());
+        assert(inPlace == expected);
+
+        string palindrome = text + expected;
+        string oddPalindrome = text + "x" + expected;
+        assert(isPalindromeSimd(palindrome) && isPalindromeSimd(oddPalindrome));
+        assert(isPalindrome(palindrome) && isPalindrome(oddPalindrome));
+        if (n > 0) {
+            palindrome[random() % n] ^= 1;
+            assert(!isPalindromeSimd(palindrome) && !isPalindrome(palindrome));
+        }
+        assert(isPalindromeSimd(text) == isPalindrome(text));
+    }
+
+    // Code points, not bytes, are reversed: 2, 3 and 4 byte sequences among ASCII.
+    assert(reversedUtf8String("") == "");
+    assert(reversedUtf8String("a\xC3\xA9z") == "z\xC3\xA9" "a");
+    assert(reversedUtf8String("\xE2\x82\xAC\xF0\x9F\x98\x80") == "\xF0\x9F\x98\x80\xE2\x82\xAC");
+    const string pieces[] = { "a", "b", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80" };
+    for (int trial = 0; trial < 300; trial++) {
+        vector<int> picks(random() % 80);
+        for (int& pick : picks) {
+            pick = random() % (trial % 3 == 0 ? 2 : 5);
+        }
+        string text;
+        string expected;
+        for (int pick : picks) {
+            text += pieces[pick];
+        }
+        for (int i = (int)picks.size() - 1; i >= 0; i--) {
+            expected += pieces[picks[i]];
+        }
+        assert(reversedUtf8String(text) == expected);
+        assert(isPalindromeUtf8(text + expected));
+        assert(isPalindromeUtf8(text + "\xE2\x82\xAC" + expected));
+        assert(isPalindromeUtf8(text) == (text == expected));
+    }
+    assert(!isPalindromeUtf8("\xC3\xA9\xA9\xC3"));
+    assert(isPalindrome("\xC3\xA9\xA9\xC3"));
+}
+
+void stringKernelBigO(int maxSize) {
+    for (int n = 1 << 10; n <= maxSize; n <<= 4) {
+        string text(n, ' ');
+        for (int i = 0; i < n; i++) {
+            text[i] = char('a' + i % 26);
+        }
+        string palindrome = text + reversedStringSimd(text);
+        int repeats = (1 << 24) / n;
+
+        long long checksum = 0;
+        auto begin = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            checksum += reversedString(text)[r % n] + isPalindrome(palindrome);
+        }
+        auto stackTime = chrono::steady_clock::now() - begin;
+
+        begin = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            checksum += reversedStringSimd(text)[r % n] + isPalindromeSimd(palindrome);
+        }
+        auto simdTime = chrono::steady_clock::now() - begin;
+
+        begin = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            checksum += reversedUtf8String(text)[r % n] + isPalindromeUtf8(palindrome);
+        }
+        auto utf8Time = chrono::steady_clock::now() - begin;
+
+        cout << "size " << n << ": stack reverse + palindrome " << chrono::duration<double, milli>(stackTime).count()
+            << " ms, SIMD " << chrono::duration<double, milli>(simdTime).count()
+            << " ms, UTF-8 SIMD " << chrono::duration<double, milli>(utf8Time).count() << " ms" << endl;
+
+        // Keeps the compiler from skipping the kernels.
+        volatile long long sink = checksum;
+        (void)sink;
+    }
+}
+
+// Pushes bursts of 1, 2, 4, ... n ints onto a Stack and pops each burst back off.
+template<typename Stack>
+long long churnStack(int n) {
+    Stack stack;
+    long long checksum = 0;
+    for (int burst = 1; burst <= n; burst *= 2) {
+        for (int i = 0; i < burst; i++) {
+            stack.push(i);
+        }
+        while (!stack.isEmpty()) {
+            checksum += stack.peek();
+            stack.pop();
+        }
+    }
+    return checksum;
+}
+
+void stackBigO(int maxSize) {
+    for (int n = 1 << 10; n <= maxSize; n <<= 4) {
+        string text(n, 'x');
+        for (int i = 0; i < n; i++) {
+            text[i] = char('a' + i % 26);
+        }
+
+        auto begin = chrono::steady_clock::now();
+        long long checksum = churnStack<ListStack<int>>(n);
+        checksum += reversedString<ListStack<char>>(text).length();
+        auto listTime = chrono::steady_clock::now() - begin;
+
+        begin = chrono::steady_clock::now();
+        checksum += churnStack<ChunkedStack<int>>(n);
+        checksum += reversedString<ChunkedStack<char>>(text).length();
+        auto chunkedTime = chrono::steady_clock::now() - begin;
+
+        cout << "size " << n << ": ListStack " << chrono::duration<double, milli>(listTime).count()
+            << " ms, ChunkedStack " << chrono::duration<double, milli>(chunkedTime).count() << " ms" << endl;
+
+        // Keeps the compiler from skipping the stack work.
+        volatile long long sink = checksum;
+        (void)sink;
+    }
+}
+
+// Helper for infixToPostFix.
+constexpr int precedence(char op) {
+    if (op == '*' || op == '/') {
+        return 2;
+    }
+    else {
+        assert(op == '+' || op == '-');
+        return 1;
+    }
+}
+
+// Helper for infixToPostFix.
+constexpr bool isOperator(char ch) {
+    return ch == '+' || ch == '-' || ch == '*' || ch == '/';
+}
+
+// Helper for infixToPostFix. Spelled out rather than isalpha so that it works at compile
+// time and doesn't depend on the locale.
+constexpr bool isOperand(char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+template<StackLike Stack = ArrayStack<char, MIN_ARRAY_SIZE, true>>
+constexpr string infixToPostFix(const string& infix) {
+    Stack opStack;
+    string postfix;
+    for (int i = 0; i < infix.length(); i++) {
+        char thisChar = infix[i];
+        if (isOperand(thisChar)) {
+            postfix += thisChar;
+        }
+        else if (thisChar == '(') {
+            opStack.push(thisChar);
+        }
+        else if (isOperator(thisChar)) {
+            while (not opStack.isEmpty() and opStack.peek() != '(' and precedence(thisChar) <= precedence(opStack.peek())) {
+                postfix += opStack.peek();
+                opStack.pop();
+            }
+            opStack.push(thisChar);
+        }
+        else if (thisChar == ')') {
+            while (opStack.peek() != '(') {
+                postfix += opStack.peek();
+                opStack.pop();
+            }
+            opStack.pop();
+        }
+    }
+
+    while (not opStack.isEmpty()) {
+        postfix += opStack.peek();
+        opStack.pop();
+    }
+    return postfix;
+}
+
+void testInfixToPostFix() {
+    assert(infixToPostFix("").empty());
+
+    assert(infixToPostFix("a") == "a");
+    assert(infixToPostFix("a+b") == "ab+");
+    assert(infixToPostFix("a*b") == "ab*");
+
+    assert(infixToPostFix("a+b*c") == "abc*+");
+    assert(infixToPostFix("a+(b*c)") == "abc*+");
+    assert(infixToPostFix("(a+(b*c))") == "abc*+");
+
+    assert(infixToPostFix("(a+b)*c") == "ab+c*");
+    assert(infixToPostFix("((a+b)*c)") == "ab+c*");
+
+    assert(infixToPostFix("a*b+c") == "ab*c+");
+    assert(infixToPostFix("(a*b)+c") == "ab*c+");
+    assert(infixToPostFix("((a*b)+c)") == "ab*c+");
+
+    assert(infixToPostFix<VirtualStack<ChunkedStack<char>>>("(a+b)*c-d/e") == "ab+c*de/-");
+    assert(infixToPostFix<ListStack<char>>("a-b*(c+d)") == "abcd+*-");
+}
+
+// Array-backed StackLike that works in constant expressions, so infixToPostFix can run at
+// compile time. ArrayStack can't, since it placement-constructs into raw storage; this
+// one needs a default-constructible T instead.
+template<typename T, int N>
+class FixedStack {
+private:
+    T items[N]{};
+    int topIndex = -1;
+public:
+    using value_type = T;
+
+    constexpr bool isEmpty() const {
+        return topIndex < 0;
+    }
+
+    constexpr void push(const T& value) {
+        if (topIndex + 1 >= N) {
+            throw std::length_error("Max array exceeded.");
+        }
+        topIndex += 1;
+        items[topIndex] = value;
+    }
+
+    constexpr T peek() const {
+        if (isEmpty()) {
+            throw std::logic_error("Peek on empty FixedStack.");
+        }
+        return items[topIndex];
+    }
+
+    constexpr bool pop() {
+        if (isEmpty()) {
+            return false;
+        }
+        topIndex -= 1;
+        return true;
+    }
+};
+
+void testConstexprInfixToPostFix() {
+    using Stack = FixedStack<char, MIN_ARRAY_SIZE>;
+    static_assert(infixToPostFix<Stack>("").empty());
+
+    static_assert(infixToPostFix<Stack>("a") == "a");
+    static_assert(infixToPostFix<Stack>("a+b") == "ab+");
+    static_assert(infixToPostFix<Stack>("a*b") == "ab*");
+
+    static_assert(infixToPostFix<Stack>("a+b*c") == "abc*+");
+    static_assert(infixToPostFix<Stack>("a+(b*c)") == "abc*+");
+    static_assert(infixToPostFix<Stack>("(a+(b*c))") == "abc*+");
+
+    static_assert(infixToPostFix<Stack>("(a+b)*c") == "ab+c*");
+    static_assert(infixToPostFix<Stack>("((a+b)*c)") == "ab+c*");
+
+    static_assert(infixToPostFix<Stack>("a*b+c") == "ab*c+");
+    static_assert(infixToPostFix<Stack>("(a*b)+c") == "ab*c+");
+    static_assert(infixToPostFix<Stack>("((a*b)+c)") == "ab*c+");
+
+    // The same stack still works at run time.
+    assert(infixToPostFix<Stack>("a-b/c") == "abc/-");
+}
+
+// Runs the stack algorithms on the same inputs with Stack; returns a checksum.
+template<typename Stack>
+long long runStackAlgorithms(const string& braces, const string& palindrome, const string& infix) {
+    long long checksum = areCurleyBracesMatched<Stack>(braces);
+    checksum += isPalindrome<Stack>(palindrome);
+    checksum += infixToPostFix<Stack>(infix).length();
+    return checksum;
+}
+
+void stackDispatchBigO(int maxSize) {
+    using StaticStack = ArrayStack<char, MIN_ARRAY_SIZE, true>;
+    for (int n = 1 << 10; n <= maxSize; n <<= 4) {
+        string braces;
+        string infix = "a";
+        while ((int)braces.length() < n) {
+            braces += "{x{y}z}";
+            infix += "+b*(c-d)/e";
+        }
+        string palindrome(n, 'p');
+        int repeats = (1 << 22) / n;
+
+        long long checksum = 0;
+        auto begin = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            checksum += runStackAlgorithms<StaticStack>(braces, palindrome, infix);
+        }
+        auto staticTime = chrono::steady_clock::now() - begin;
+
+        begin = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            checksum += runStackAlgorithms<VirtualStack<StaticStack>>(braces, palindrome, infix);
+        }
+        auto virtualTime = chrono::steady_clock::now() - begin;
+
+        cout << "size " << n << ": static dispatch " << chrono::duration<double, milli>(staticTime).count()
+            << " ms, through StackADT " << chrono::duration<double, milli>(virtualTime).count() << " ms" << endl;
+
+        // Keeps the compiler from skipping the algorithms.
+        volatile long long sink = checksum;
+        (void)sink;
+    }
+}
+
+enum class TokenKind {
+    Number,
+    Identifier,
+    Operator,
+    Negate,
+    LeftParen,
+    RightParen
+};
+
+struct Token {
+    TokenKind kind;
+    char symbol;   // operator or parenthesis character
+    double number; // value of a Number token
+    string name;   // text of an Identifier token
+    size_t offset; // position in the source expression, for error messages
+};
+
+// Splits an infix expression into numbers, identifiers ([A-Za-z_][A-Za-z0-9_]*), the four
+// binary operators and parentheses. A '-' that can't be binary (at the start, or after an
+// operator or '(') becomes a Negate token.
+vector<Token> tokenize(const string& expression) {
+    vector<Token> tokens;
+    size_t i = 0;
+    while (i < expression.length()) {
+        char ch = expression[i];
+        bool expectOperand = tokens.empty() || tokens.back().kind == TokenKind::Operator
+            || tokens.back().kind == TokenKind::Negate || tokens.back().kind == TokenKind::LeftParen;
+        if (isspace((unsigned char)ch)) {
+            i++;
+        }
+        else if (isdigit((unsigned char)ch) || ch == '.') {
+            double value;
+            from_chars_result parsed = from_chars(expression.data() + i, expression.data() + expression.length(), value);
+            if (parsed.ec != errc()) {
+                throw invalid_argument("Invalid number at offset " + to_string(i) + ".");
+            }
+            tokens.push_back({TokenKind::Number, 0, value, "", i});
+            i = parsed.ptr - expression.data();
+        }
+        else if (isalpha((unsigned char)ch) || ch == '_') {
+            size_t start = i;
+            while (i < expression.length() && (isalnum((unsigned char)expression[i]) || expression[i] == '_')) {
+                i++;
+            }
+            tokens.push_back({TokenKind::Identifier, 0, 0, expression.substr(start, i - start), start});
+        }
+        else if (ch == '-' && expectOperand) {
+            tokens.push_back({TokenKind::Negate, ch, 0, "", i++});
+        }
+        else if (isOperator(ch)) {
+            tokens.push_back({TokenKind::Operator, ch, 0, "", i++});
+        }
+        else if (ch == '(' || ch == ')') {
+            tokens.push_back({ch == '(' ? TokenKind::LeftParen : TokenKind::RightParen, ch, 0, "", i++});
+        }
+        else {
+            throw invalid_argument("Unexpected character at offset " + to_string(i) + ".");
+        }
+    }
+    return tokens;
+}
+
+// infixToPostFix over tokens. Negate binds tighter than any binary operator and is right
+// associative, so it never pops anything when pushed.
+vector<Token> tokensToPostfix(const vector<Token>& tokens) {
+    ArrayStack<Token, MIN_ARRAY_SIZE, true> opStack;
+    vector<Token> postfix;
+    for (const Token& token : tokens) {
+        if (token.kind == TokenKind::Number || token.kind == TokenKind::Identifier) {
+            postfix.push_back(token);
+        }
+        else if (token.kind == TokenKind::LeftParen || token.kind == TokenKind::Negate) {
+            opStack.push(token);
+        }
+        else if (token.kind == TokenKind::Operator) {
+            while (not opStack.isEmpty() and opStack.top().kind != TokenKind::LeftParen
+                and (opStack.top().kind == TokenKind::Negate or precedence(token.symbol) <= precedence(opStack.top().symbol))) {
+                postfix.push_back(opStack.popValue());
+            }
+            opStack.push(token);
+        }
+        else {
+            while (not opStack.isEmpty() and opStack.top().kind != TokenKind::LeftParen) {
+                postfix.push_back(opStack.popValue());
+            }
+            if (opStack.isEmpty()) {
+                throw invalid_argument("Unmatched ')' at offset " + to_string(token.offset) + ".");
+            }
+            opStack.pop();
+        }
+    }
+
+    while (not opStack.isEmpty()) {
+        if (opStack.top().kind == TokenKind::LeftParen) {
+            throw invalid_argument("Unmatched '(' at offset " + to_string(opStack.top().offset) + ".");
+        }
+        postfix.push_back(opStack.popValue());
+    }
+    return postfix;
+}
+
+enum class OpCode : uint8_t {
+    PushConstant,
+    PushVariable,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Negate
+};
+
+struct Instruction {
+    OpCode op;
+    int operand; // constant or variable index for the push instructions
+};
+
+constexpr size_t EXPRESSION_BLOCK_ROWS = 256;
+
+// An infix formula compiled once to stack bytecode and then evaluated many times, either
+// one row at a time or over whole columns. Variables are numbered in order of first use;
+// getVariables() gives the order in which their values or columns must be passed.
+class CompiledExpression {
+private:
+    vector<Instruction> program;
+    vector<double> constants;
+    vector<string> variables;
+    int maxDepth;
+
+public:
+    // Throws: invalid_argument naming the offset of the problem if expression is malformed.
+    explicit CompiledExpression(const string& expression) : maxDepth(0) {
+        int depth = 0;
+        for (const Token& token : tokensToPostfix(tokenize(expression))) {
+            switch (token.kind) {
+            case TokenKind::Number:
+                program.push_back({OpCode::PushConstant, (int)constants.size()});
+                constants.push_back(token.number);
+                depth++;
+                break;
+            case TokenKind::Identifier: {
+                auto found = find(variables.begin(), variables.end(), token.name);
+                if (found == variables.end()) {
+                    variables.push_back(token.name);
+                    found = variables.end() - 1;
+                }
+                program.push_back({OpCode::PushVariable, (int)(found - variables.begin())});
+                depth++;
+                break;
+            }
+            case TokenKind::Negate:
+                if (depth < 1) {
+                    throw invalid_argument("Missing operand for '-' at offset " + to_string(token.offset) + ".");
+                }
+                program.push_back({OpCode::Negate, 0});
+                break;
+            default: {
+                if (depth < 2) {
+                    throw invalid_argument(string("Missing operand for '") + token.symbol + "' at offset " + to_string(token.offset) + ".");
+                }
+                OpCode op = token.symbol == '+' ? OpCode::Add : token.symbol == '-' ? OpCode::Subtract
+                    : token.symbol == '*' ? OpCode::Multiply : OpCode::Divide;
+                program.push_back({op, 0});
+                depth--;
+                break;
+            }
+            }
+            maxDepth = max(maxDepth, depth);
+        }
+        if (depth != 1) {
+            throw invalid_argument(depth == 0 ? "Empty expression." : "Missing operator between operands.");
+        }
+    }
+
+    const vector<string>& getVariables() const {
+        return variables;
+    }
+
+    // Approximate heap and object footprint, for callers that budget memory.
+    size_t memoryBytes() const {
+        size_t bytes = sizeof(*this) + program.capacity() * sizeof(Instruction) + constants.capacity() * sizeof(double);
+        for (const string& name : variables) {
+            bytes += sizeof(string) + name.capacity();
+        }
+        return bytes;
+    }
+
+    // Postfix form with tokens separated by spaces and negation written as '~'.
+    string toPostfix() const {
+        string out;
+        for (const Instruction& instruction : program) {
+            if (!out.empty()) {
+                out += ' ';
+            }
+            switch (instruction.op) {
+            case OpCode::PushConstant: {
+                ostringstream number;
+                number << constants[instruction.operand];
+                out += number.str();
+                break;
+            }
+            case OpCode::PushVariable: out += variables[instruction.operand]; break;
+            case OpCode::Add: out += '+'; break;
+            case OpCode::Subtract: out += '-'; break;
+            case OpCode::Multiply: out += '*'; break;
+            case OpCode::Divide: out += '/'; break;
+            case OpCode::Negate: out += '~'; break;
+            }
+        }
+        return out;
+    }
+
+    // Evaluates a single row; values[v] is the value of getVariables()[v].
+    double evaluate(const double* values) const {
+        double stackStorage[MIN_ARRAY_SIZE];
+        vector<double> bigStack(maxDepth > MIN_ARRAY_SIZE ? maxDepth : 0);
+        double* stack = maxDepth > MIN_ARRAY_SIZE ? bigStack.data() : stackStorage;
+        int top = -1;
+        for (const Instruction& instruction : program) {
+            switch (instruction.op) {
+            case OpCode::PushConstant: stack[++top] = constants[instruction.operand]; break;
+            case OpCode::PushVariable: stack[++top] = values[instruction.operand]; break;
+            case OpCode::Add: top--; stack[top] += stack[top + 1]; break;
+            case OpCode::Subtract: top--; stack[top] -= stack[top + 1]; break;
+            case OpCode::Multiply: top--; stack[top] *= stack[top + 1]; break;
+            case OpCode::Divide: top--; stack[top] /= stack[top + 1]; break;
+            case OpCode::Negate: stack[top] = -stack[top]; break;
+            }
+        }
+        return stack[0];
+    }
+
+    // Evaluates rows [0, rows) of the columns, where columns[v] holds getVariables()[v], into
+    // out. Instructions are dispatched once per block of EXPRESSION_BLOCK_ROWS rows and
+    // each one is a plain loop over the block, which the compiler vectorizes. Stack slots
+    // are pointers, so pushing a column or constant copies nothing.
+    void evaluate(const vector<const double*>& columns, size_t rows, double* out) const {
+        if (columns.size() != variables.size()) {
+            throw invalid_argument("Expected one column per variable.");
+        }
+        const size_t B = EXPRESSION_BLOCK_ROWS;
+        vector<double> constantBlocks(constants.size() * B);
+        for (size_t c = 0; c < constants.size(); c++) {
+            fill(constantBlocks.begin() + c * B, constantBlocks.begin() + (c + 1) * B, constants[c]);
+        }
+        vector<double> scratch(maxDepth * B);
+        vector<const double*> slots(maxDepth);
+
+        for (size_t start = 0; start < rows; start += B) {
+            size_t count = min(B, rows - start);
+            int top = -1;
+            for (const Instruction& instruction : program) {
+                if (instruction.op == OpCode::PushConstant) {
+                    slots[++top] = constantBlocks.data() + instruction.operand * B;
+                    continue;
+                }
+                if (instruction.op == OpCode::PushVariable) {
+                    slots[++top] = columns[instruction.operand] + start;
+                    continue;
+                }
+                if (instruction.op == OpCode::Negate) {
+                    double* result = scratch.data() + top * B;
+                    const double* a = slots[top];
+                    for (size_t i = 0; i < count; i++) {
+                        result[i] = -a[i];
+                    }
+                    slots[top] = result;
+                    continue;
+                }
+                top--;
+                double* result = scratch.data() + top * B;
+                const double* a = slots[top];
+                const double* b = slots[top + 1];
+                switch (instruction.op) {
+                case OpCode::Add:
+                    for (size_t i = 0; i < count; i++) result[i] = a[i] + b[i];
+                    break;
+                case OpCode::Subtract:
+                    for (size_t i = 0; i < count; i++) result[i] = a[i] - b[i];
+                    break;
+                case OpCode::Multiply:
+                    for (size_t i = 0; i < count; i++) result[i] = a[i] * b[i];
+                    break;
+                default:
+                    for (size_t i = 0; i < count; i++) result[i] = a[i] / b[i];
+                    break;
+                }
+                slots[top] = result;
+            }
+            copy(slots[0], slots[0] + count, out + start);
+        }
+    }
+};
+
+void testCompiledExpression() {
+    // Single-letter expressions compile to the same postfix as infixToPostFix.
+    for (const string infix : { "a", "a+b", "a*b", "a+b*c", "(a+(b*c))", "((a+b)*c)", "(a*b)+c", "a-b-c", "a/b*c" }) {
+        string postfix = CompiledExpression(infix).toPostfix();
+        postfix.erase(remove(postfix.begin(), postfix.end(), ' '), postfix.end());
+        assert(postfix == infixToPostFix(infix));
+    }
+
+    assert(CompiledExpression("price * qty_2 - 1.5").toPostfix() == "price qty_2 * 1.5 -");
+    assert(CompiledExpression("-a * -(b + 2)").toPostfix() == "a ~ b 2 + ~ *");
+    assert(CompiledExpression("2 - -3").evaluate(nullptr) == 5);
+    assert(CompiledExpression("10 / 4 - 2 * 3").evaluate(nullptr) == -3.5);
+    assert(CompiledExpression("1e3 + .5").evaluate(nullptr) == 1000.5);
+
+    CompiledExpression expression("(x + y) * x - -z / 2");
+    assert((expression.getVariables() == vector<string>{ "x", "y", "z" }));
+    double row[] = { 3, 4, 8 };
+    assert(expression.evaluate(row) == 25);
+
+    for (const string bad : { "", "a+", "(a", "a)", "a b", "3 $ 4", "*a", "()", "-" }) {
+        bool threw = false;
+        try {
+            CompiledExpression compiled(bad);
+        }
+        catch (const invalid_argument&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    // Columnar evaluation matches the row evaluator, including a partial last block and
+    // an expression deep enough to need more than MIN_ARRAY_SIZE stack slots.
+    string deep = string(80, '(') + "x" + string(80, ')');
+    for (int i = 0; i < 70; i++) {
+        deep = "x-(" + deep + ")";
+    }
+    mt19937 random(23);
+    uniform_real_distribution<double> distribution(-10, 10);
+    for (const string& formula : { string("(x + y) * x - -z / 2"), string("x"), string("-7"), deep }) {
+        CompiledExpression compiled(formula);
+        size_t variableCount = compiled.getVariables().size();
+        const size_t rows = 3 * EXPRESSION_BLOCK_ROWS + 17;
+        vector<vector<double>> data(variableCount, vector<double>(rows));
+        vector<const double*> columns;
+        for (vector<double>& column : data) {
+            for (double& value : column) {
+                value = distribution(random);
+            }
+            columns.push_back(column.data());
+        }
+        vector<double> out(rows);
+        compiled.evaluate(columns, rows, out.data());
+        for (size_t r = 0; r < rows; r++) {
+            vector<double> values;
+            for (const vector<double>& column : data) {
+                values.push_back(column[r]);
+            }
+            assert(out[r] == compiled.evaluate(values.data()));
+        }
+    }
+}
+
+void compiledExpressionBigO(int maxRows) {
+    CompiledExpression expression("(price * quantity - discount) / (1 + taxRate) * -margin + 2.5");
+    for (int rows = 1 << 12; rows <= maxRows; rows <<= 4) {
+        vector<vector<double>> data(expression.getVariables().size(), vector<double>(rows));
+        for (size_t v = 0; v < data.size(); v++) {
+            for (int r = 0; r < rows; r++) {
+                data[v][r] = 1.0 + (r * (v + 3) % 101) * 0.01;
+            }
+        }
+        vector<const double*> columns;
+        for (vector<double>& column : data) {
+            columns.push_back(column.data());
+        }
+        vector<double> out(rows);
+        int repeats = (1 << 24) / rows;
+
+        double checksum = 0;
+        auto begin = chrono::steady_clock::now();
+        for (int repeat = 0; repeat < repeats; repeat++) {
+            double values[5];
+            for (int r = 0; r < rows; r++) {
+                for (size_t v = 0; v < data.size(); v++) {
+                    values[v] = data[v][r];
+                }
+                out[r] = expression.evaluate(values);
+            }
+            checksum += out[repeat % rows];
+        }
+        auto rowTime = chrono::steady_clock::now() - begin;
+
+        begin = chrono::steady_clock::now();
+        for (int repeat = 0; repeat < repeats; repeat++) {
+            expression.evaluate(columns, rows, out.data());
+            checksum += out[repeat % rows];
+        }
+        auto columnTime = chrono::steady_clock::now() - begin;
+
+        begin = chrono::steady_clock::now();
+        for (int repeat = 0; repeat < repeats; repeat++) {
+            for (int r = 0; r < rows; r++) {
+                out[r] = (columns[0][r] * columns[1][r] - columns[2][r]) / (1 + columns[3][r]) * -columns[4][r] + 2.5;
+            }
+            checksum += out[repeat % rows];
+        }
+        auto nativeTime = chrono::steady_clock::now() - begin;
+
+        auto nsPerRow = [&](chrono::steady_clock::duration d) {
+            return chrono::duration<double, nano>(d).count() / ((double)rows * repeats);
+        };
+        cout << "rows " << rows << ": row VM " << nsPerRow(rowTime) << " ns, columnar VM " << nsPerRow(columnTime)
+            << " ns, native C++ " << nsPerRow(nativeTime) << " ns per row" << endl;
+
+        // Keeps the compiler from skipping the evaluation.
+        volatile double sink = checksum;
+        (void)sink;
+    }
+}
+
+constexpr size_t CACHE_ENTRY_OVERHEAD = 128; // list node, hash bucket and control block, roughly
+
+// Thread-safe cache of compiled formulas keyed by their text, so formulas that keep coming
+// back are parsed once. Keys are hashed to independently locked shards; each shard keeps
+// its entries in least-recently-used order and evicts from the back once it is over its
+// share of the memory budget. Formulas are compiled outside the shard lock, so a slow
+// compile never blocks lookups of other formulas.
+class ExpressionCache {
+private:
+    struct Entry {
+        string text;
+        shared_ptr<const CompiledExpression> compiled;
+        size_t bytes;
+    };
+
+    struct Shard {
+        mutex lock;
+        list<Entry> entries; // most recently used first
+        unordered_map<string, list<Entry>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    vector<Shard> shards;
+    size_t shardBudget;
+    atomic<long long> hits{0};
+    atomic<long long> misses{0};
+    atomic<long long> evictions{0};
+
+    Shard& shardFor(const string& text) {
+        return shards[hash<string>()(text) % shards.size()];
+    }
+
+public:
+    explicit ExpressionCache(size_t memoryBudget, int shardCount = 16)
+        : shards(max(shardCount, 1)), shardBudget(memoryBudget / max(shardCount, 1)) {}
+
+    // Returns the compiled form of text, compiling and caching it on a miss.
+    //
+    // Throws: invalid_argument if text is not a valid formula; nothing is cached then.
+    shared_ptr<const CompiledExpression> get(const string& text) {
+        Shard& shard = shardFor(text);
+        {
+            lock_guard<mutex> guard(shard.lock);
+            auto found = shard.index.find(text);
+            if (found != shard.index.end()) {
+                shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+                hits++;
+                return found->second->compiled;
+            }
+        }
+        misses++;
+
+        auto compiled = make_shared<const CompiledExpression>(text);
+        size_t bytes = 2 * text.capacity() + compiled->memoryBytes() + CACHE_ENTRY_OVERHEAD;
+        if (bytes > shardBudget) {
+            return compiled;
+        }
+
+        lock_guard<mutex> guard(shard.lock);
+        auto found = shard.index.find(text);
+        if (found != shard.index.end()) {
+            // Another thread compiled it meanwhile; keep theirs so callers share one copy.
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            return found->second->compiled;
+        }
+        shard.entries.push_front({text, compiled, bytes});
+        shard.index.emplace(text, shard.entries.begin());
+        shard.bytes += bytes;
+        while (shard.bytes > shardBudget) {
+            Entry& oldest = shard.entries.back();
+            shard.bytes -= oldest.bytes;
+            shard.index.erase(oldest.text);
+            shard.entries.pop_back();
+            evictions++;
+        }
+        return compiled;
+    }
+
+    long long getHits() const {
+        return hits.load();
+    }
+
+    long long getMisses() const {
+        return misses.load();
+    }
+
+    long long getEvictions() const {
+        return evictions.load();
+    }
+
+    double getHitRate() const {
+        long long lookups = getHits() + getMisses();
+        return lookups == 0 ? 0 : (double)getHits() / lookups;
+    }
+
+    size_t size() {
+        size_t count = 0;
+        for (Shard& shard : shards) {
+            lock_guard<mutex> guard(shard.lock);
+            count += shard.entries.size();
+        }
+        return count;
+    }
+
+    size_t memoryBytes() {
+        size_t bytes = 0;
+        for (Shard& shard : shards) {
+            lock_guard<mutex> guard(shard.lock);
+            bytes += shard.bytes;
+        }
+        return bytes;
+    }
+};
+
+void testExpressionCache() {
+    ExpressionCache cache(1 << 20);
+    auto first = cache.get("(price + tax) * qty");
+    auto second = cache.get("(price + tax) * qty");
+    assert(first == second);
+    assert(cache.getHits() == 1 && cache.getMisses() == 1 && cache.size() == 1);
+    double row[] = { 2, 1, 4 };
+    assert(second->evaluate(row) == 12);
+
+    bool threw = false;
+    try {
+        cache.get("price +");
+    }
+    catch (const invalid_argument&) {
+        threw = true;
+    }
+    assert(threw && cache.size() == 1);
+
+    // A single shard with room for about three entries evicts the least recently used.
+    ExpressionCache probe(1 << 20);
+    probe.get("a9 + 1");
+    size_t entryBytes = probe.memoryBytes();
+    ExpressionCache small(entryBytes * 3 + entryBytes / 2, 1);
+    small.get("a0 + 1");
+    small.get("a1 + 1");
+    small.get("a2 + 1");
+    small.get("a0 + 1");
+    small.get("a3 + 1");
+    assert(small.getEvictions() == 1 && small.size() == 3);
+    assert(small.memoryBytes() <= entryBytes * 3 + entryBytes / 2);
+    long long hitsBefore = small.getHits();
+    small.get("a0 + 1");
+    assert(small.getHits() == hitsBefore + 1);
+    small.get("a1 + 1");
+    assert(small.getMisses() == 5);
+
+    // Threads hammering an overlapping set of formulas see consistent results.
+    ExpressionCache shared(1 << 16, 4);
+    vector<thread> threads;
+    atomic<int> wrong{0};
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&shared, &wrong, t]() {
+            for (int i = 0; i < 2000; i++) {
+                int k = (i * 7 + t) % 300;
+                auto compiled = shared.get("x * " + to_string(k) + " + 1");
+                double x = 2;
+                if (compiled->evaluate(&x) != 2.0 * k + 1) {
+                    wrong++;
+                }
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    assert(wrong == 0);
+    assert(shared.getHits() + shared.getMisses() == 8000);
+    assert(shared.memoryBytes() <= (1 << 16));
+}
+
+// Cost per request with and without the cache when a given share of requests repeat
+// one of a few thousand hot formulas and the rest are new.
+void expressionCacheBigO(int requests) {
+    const int hotCount = 4000;
+    auto formula = [](int id) {
+        return "(price * quantity - discount" + to_string(id) + ") / (1 + taxRate) * -margin + " + to_string(id % 97);
+    };
+
+    for (double hitRate : { 0.0, 0.5, 0.9, 0.99 }) {
+        mt19937 random(25);
+        bernoulli_distribution isHot(hitRate);
+        vector<string> texts;
+        int nextCold = hotCount;
+        for (int i = 0; i < requests; i++) {
+            texts.push_back(isHot(random) ? formula((int)(random() % hotCount)) : formula(nextCold++));
+        }
+        ExpressionCache cache(64 << 20);
+        for (int id = 0; id < hotCount; id++) {
+            cache.get(formula(id));
+        }
+        long long hitsBefore = cache.getHits();
+
+        double checksum = 0;
+        auto begin = chrono::steady_clock::now();
+        for (const string& text : texts) {
+            checksum += CompiledExpression(text).getVariables().size();
+        }
+        auto uncachedTime = chrono::steady_clock::now() - begin;
+
+        begin = chrono::steady_clock::now();
+        for (const string& text : texts) {
+            checksum += cache.get(text)->getVariables().size();
+        }
+        auto cachedTime = chrono::steady_clock::now() - begin;
+
+        auto nsPerRequest = [requests](chrono::steady_clock::duration d) {
+            return chrono::duration<double, nano>(d).count() / requests;
+        };
+        cout << "hit rate " << (double)(cache.getHits() - hitsBefore) / requests << ": compile every time "
+            << nsPerRequest(uncachedTime) << " ns, ExpressionCache " << nsPerRequest(cachedTime)
+            << " ns per request, " << cache.getEvictions() << " evictions" << endl;
+
+        // Keeps the compiler from skipping the lookups.
+        volatile double sink = checksum;
+        (void)sink;
+    }
+}
+
+// String literal usable as a template argument, e.g. Formula<"(a+b)*c">.
+template<size_t N>
+struct FixedString {
+    char chars[N]{};
+
+    constexpr FixedString() = default;
+
+    constexpr FixedString(const char (&text)[N]) {
+        copy_n(text, N, chars);
+    }
+
+    constexpr size_t length() const {
+        size_t n = 0;
+        while (n < N && chars[n] != '\0') {
+            n++;
+        }
+        return n;
+    }
+};
+
+// infixToPostFix of Infix, computed during compilation. Postfix never has more characters
+// than infix, so it fits a FixedString of the same size.
+template<FixedString Infix>
+constexpr auto fixedPostFix() {
+    string infix(Infix.length(), ' ');
+    copy_n(Infix.chars, infix.length(), infix.begin());
+    string postfix = infixToPostFix<FixedStack<char, MIN_ARRAY_SIZE>>(infix);
+    FixedString<sizeof(Infix.chars)> out;
+    copy(postfix.begin(), postfix.end(), out.chars);
+    return out;
+}
+
+// True if postfix leaves exactly one value: every operator has two operands.
+constexpr bool isWellFormedPostFix(const char* postfix, size_t length) {
+    int depth = 0;
+    for (size_t i = 0; i < length; i++) {
+        depth += isOperator(postfix[i]) ? -1 : 1;
+        if (depth < 1) {
+            return false;
+        }
+    }
+    return depth == 1;
+}
+
+// Start of the subexpression whose last character is postfix[end - 1].
+constexpr size_t subexpressionStart(const char* postfix, size_t end) {
+    int needed = 1;
+    size_t i = end;
+    while (needed > 0) {
+        i--;
+        needed += isOperator(postfix[i]) ? 1 : -1;
+    }
+    return i;
+}
+
+// Expression-template nodes: a Formula's tree lives entirely in its type, so evaluating it
+// inlines to straight-line arithmetic on the bindings.
+template<char Name>
+struct OperandNode {
+    template<typename Bindings>
+    static constexpr double evaluate(const Bindings& bindings) {
+        return bindings[Name];
+    }
+};
+
+template<char Op, typename Left, typename Right>
+struct OperatorNode {
+    template<typename Bindings>
+    static constexpr double evaluate(const Bindings& bindings) {
+        double left = Left::evaluate(bindings);
+        double right = Right::evaluate(bindings);
+        if constexpr (Op == '+') {
+            return left + right;
+        }
+        else if constexpr (Op == '-') {
+            return left - right;
+        }
+        else if constexpr (Op == '*') {
+            return left * right;
+        }
+        else {
+            return left / right;
+        }
+    }
+};
+
+// Node type for the subexpression of Postfix ending just before End.
+template<FixedString Postfix, size_t End>
+constexpr auto buildFormulaNode() {
+    constexpr char ch = Postfix.chars[End - 1];
+    if constexpr (isOperator(ch)) {
+        constexpr size_t rightStart = subexpressionStart(Postfix.chars, End - 1);
+        using Left = decltype(buildFormulaNode<Postfix, rightStart>());
+        using Right = decltype(buildFormulaNode<Postfix, End - 1>());
+        return OperatorNode<ch, Left, Right>{};
+    }
+    else {
+        return OperandNode<ch>{};
+    }
+}
+
+// A formula over single-letter variables, parsed entirely at compile time. Calling it
+// with bindings, anything indexable by variable letter such as an array<double, 128>,
+// runs no parsing and uses no stack at run time.
+template<FixedString Infix>
+struct Formula {
+    static constexpr auto postfix = fixedPostFix<Infix>();
+    static_assert(isWellFormedPostFix(postfix.chars, postfix.length()), "Formula needs an operand for every operator.");
+    using Tree = decltype(buildFormulaNode<postfix, postfix.length()>());
+
+    template<typename Bindings>
+    constexpr double operator()(const Bindings& bindings) const {
+        return Tree::evaluate(bindings);
+    }
+};
+
+// Evaluates single-letter postfix at run time with a stack, the way a formula is
+// evaluated without Formula or CompiledExpression.
+template<typename Bindings>
+double evaluatePostFix(const string& postfix, const Bindings& bindings) {
+    ArrayStack<double, MIN_ARRAY_SIZE, true> values;
+    for (char ch : postfix) {
+        if (isOperand(ch)) {
+            values.push(bindings[ch]);
+            continue;
+        }
+        double right = values.popValue();
+        double left = values.popValue();
+        values.push(ch == '+' ? left + right : ch == '-' ? left - right : ch == '*' ? left * right : left / right);
+    }
+    return values.peek();
+}
+
+void testFormula() {
+    constexpr array<double, 128> bindings = [] {
+        array<double, 128> values{};
+        values['a'] = 2;
+        values['b'] = 3;
+        values['c'] = 4;
+        values['d'] = 8;
+        return values;
+    }();
+    static_assert(string_view(Formula<"(a+b)*c">::postfix.chars) == "ab+c*");
+    static_assert(Formula<"(a+b)*c">{}(bindings) == 20);
+    static_assert(Formula<"a+b*c-d/a">{}(bindings) == 10);
+    static_assert(Formula<"((a*b)+c)">{}(bindings) == 10);
+    static_assert(Formula<"a-b-c">{}(bindings) == -5);
+    static_assert(Formula<"d/a/a">{}(bindings) == 2);
+
+    array<double, 128> row{};
+    row['x'] = 1.5;
+    row['y'] = -2;
+    Formula<"(x+y)*(x-y)/x"> formula;
+    assert(formula(row) == evaluatePostFix(infixToPostFix("(x+y)*(x-y)/x"), row));
+    assert(formula(row) == CompiledExpression("(x+y)*(x-y)/x").evaluate(vector<double>{ 1.5, -2 }.data()));
+}
+
+void formulaBigO(int rows) {
+    const string infix = "(a*b-c)/(d+e)*a";
+    Formula<"(a*b-c)/(d+e)*a"> formula;
+    CompiledExpression compiled(infix);
+    vector<array<double, 128>> data(rows);
+    vector<vector<double>> compiledRows(rows);
+    for (int r = 0; r < rows; r++) {
+        for (char name : string("abcde")) {
+            data[r][name] = 1.0 + (r * (name - 'a' + 3) % 97) * 0.01;
+        }
+        for (const string& name : compiled.getVariables()) {
+            compiledRows[r].push_back(data[r][name[0]]);
+        }
+    }
+    const int repeats = 64;
+
+    double checksum = 0;
+    auto begin = chrono::steady_clock::now();
+    for (int repeat = 0; repeat < repeats; repeat++) {
+        for (int r = 0; r < rows; r++) {
+            checksum += evaluatePostFix(infixToPostFix(infix), data[r]);
+        }
+    }
+    auto parseTime = chrono::steady_clock::now() - begin;
+
+    begin = chrono::steady_clock::now();
+    for (int repeat = 0; repeat < repeats; repeat++) {
+        for (int r = 0; r < rows; r++) {
+            checksum += compiled.evaluate(compiledRows[r].data());
+        }
+    }
+    auto compiledTime = chrono::steady_clock::now() - begin;
+
+    begin = chrono::steady_clock::now();
+    for (int repeat = 0; repeat < repeats; repeat++) {
+        for (int r = 0; r < rows; r++) {
+            checksum += formula(data[r]);
+        }
+    }
+    auto formulaTime = chrono::steady_clock::now() - begin;
+
+    auto nsPerRow = [rows, repeats](chrono::steady_clock::duration d) {
+        return chrono::duration<double, nano>(d).count() / ((double)rows * repeats);
+    };
+    cout << "rows " << rows << ": infixToPostFix + stack " << nsPerRow(parseTime) << " ns, CompiledExpression "
+        << nsPerRow(compiledTime) << " ns, Formula " << nsPerRow(formulaTime) << " ns per row" << endl;
+
+    // Keeps the compiler from skipping the evaluation.
+    volatile double sink = checksum;
+    (void)sink;
+}
+
+class QueensBoard {
 private:
     int queens[8][2]; // spaces containing queens
     int topIndex = -1; // top of the "stack" (can't use an actual stack, but queens will be added in a stack-like fashion)
@@ -464,12 +3129,31 @@ string solveEightQueens() {
 int main() {
     testArrayStack();
     testListStack();
+    testChunkedStack();
+    testConcurrentStack();
     testAreCurleyBracesMatched();
+    testCheckBrackets();
+    testCheckBracketsParallel();
     testIsPalindrome();
     testReversedString();
+    testStringKernels();
     testInfixToPostFix();
+    testConstexprInfixToPostFix();
+    testCompiledExpression();
+    testExpressionCache();
+    testFormula();
 
     testQueensBoard();
-    cout << solveEightQueens();
+    cout << solveEightQueens() << endl;
+
+    stackBigO(1 << 22);
+    concurrentStackBigO(64);
+    stackDispatchBigO(1 << 20);
+    bracketBigO(1 << 24);
+    bracketFileBigO(1 << 27);
+    stringKernelBigO(1 << 22);
+    compiledExpressionBigO(1 << 22);
+    formulaBigO(1 << 12);
+    expressionCacheBigO(1 << 18);
     return 0;
 }